@@ -7,6 +7,26 @@
 #include "setup.h"
 #include "controller.h"
 #include "webServer.h"
+#include "loopStats.h"
+#include "logger.h"
+#include "scheduler.h"
+
+// task periods and deadlines [us], see scheduler.h
+#define CONTROL_PERIOD 1000     // the controller keeps its own sample grid, this is how closely it is polled
+#define CONTROL_DEADLINE 2000
+#define TRIAC_PERIOD 1000       // polled triac output (the timer drive needs nothing)
+#define TRIAC_DEADLINE 2000
+#define WEBSOCKET_PERIOD 2000
+#define WEBSOCKET_DEADLINE 20000
+#define HTTP_PERIOD 5000
+#define HTTP_DEADLINE 100000
+
+static void controlTask(void);
+static void triacTask(void);
+static void websocketTask(void);
+static void httpTask(void);
+static void logTask(void);
+
 
 void setup(void){
   Serial.begin(115200);
@@ -16,13 +36,51 @@ void setup(void){
   controller.loadConfig();
   setupWIFI();
   webserverSetup();
+
+  scheduler.add("control", controlTask, PRIORITY_CONTROL, CONTROL_PERIOD, CONTROL_DEADLINE);
+  scheduler.add("triac", triacTask, PRIORITY_TRIAC, TRIAC_PERIOD, TRIAC_DEADLINE);
+  scheduler.add("websocket", websocketTask, PRIORITY_WEBSOCKET, WEBSOCKET_PERIOD, WEBSOCKET_DEADLINE);
+  scheduler.add("http", httpTask, PRIORITY_HTTP, HTTP_PERIOD, HTTP_DEADLINE);
+  // in idle time: the log lines queued by everything else
+  scheduler.add("log", logTask, PRIORITY_IDLE, 0, 0);
 }
 
 
+// one task per loop(), the most urgent one due
 void loop(void){
+  StageTimer timer;
+  scheduler.runOnce();
+  timer.end();
+}
+
+
+void controlTask(){
+  StageTimer timer;
   controller.process();
-  //controller.triac.process();
-  server.handleClient();
+  timer.lap(STAGE_CONTROLLER);
+}
+
+void triacTask(){
+  controller.triac.process();
+}
+
+void websocketTask(){
+  StageTimer timer;
   webSocket.loop();
+  timer.lap(STAGE_WEBSOCKET);
+  webserverProcess();
+  timer.lap(STAGE_WEBSERVER);
 }
 
+// includes anything it let run with scheduler.yield()
+void httpTask(){
+  StageTimer timer;
+  server.handleClient();
+  timer.lap(STAGE_HTTP);
+}
+
+void logTask(){
+  StageTimer timer;
+  logProcess();
+  timer.lap(STAGE_LOG);
+}
@@ -1,7 +1,6 @@
-#include <FS.h>
-#include <ArduinoJson.h>
 #include "controller.h"
-#include "webServer.h"
+#include "logger.h"
+#include "controllerEvents.h"
 
 
 #define DEFAULT_P 0.4
@@ -10,8 +9,6 @@
 
 Controller controller(TRIAC_PIN, FAN_PIN, SAMPLE_INTERVAL);
 
-String config_filename = String("config.json");
-
 
 Controller::Controller(uint8_t triac_pin, uint8_t fan_pin, unsigned long sampleInterval) :
     thermocouple(SS),
@@ -22,81 +19,278 @@ Controller::Controller(uint8_t triac_pin, uint8_t fan_pin, unsigned long sampleI
   state = OFF;
   programMode = SIMPLE;
   ramp_rate = 0;
+  _targetSetpoint = 0;
+  _preheatTime = 0;
+  estimatorMode = ESTIMATOR_MODE;
 
   // initialise my objects and put into a safe state
+  triac.setDrive(TRIAC_DRIVE);
+  triac.setDistribution(TRIAC_DISTRIBUTION);
   triac.disable();
   fan.off();
   myPID.setOutputLimits(0, 100);
   myPID.setSetpoint(0);
   thermocouple.begin();
-  _prevMillis = millis();
+  _prevMicros = micros();
+  _lastSampleMicros = _prevMicros;
   _actualTime = 0;
-  _sampleInterval = sampleInterval;
+  _reportedFault = 0;
+  _reportedState = NOT_REPORTED;
+  _reportedMode = NOT_REPORTED;
+  setSampleInterval(sampleInterval);
 }
 
 
 void Controller::process(){
-  unsigned long currentMillis = millis();
-  unsigned long elapsed_time = currentMillis - _prevMillis;
-  if(elapsed_time > _sampleInterval){
-    _actualTime += elapsed_time/1000.0;
-    _prevMillis = currentMillis;
+  thermocouple.process();
+
+  // start()/stop() are called from the web layer, the change goes out from here so there is one producer
+  if(state != _reportedState || programMode != _reportedMode){
+    ControllerEvent event;
+    event.type = EVENT_STATE;
+    event.state.state = state;
+    event.state.programMode = programMode;
+    if(publishEvent(event)){
+      _reportedState = state;
+      _reportedMode = programMode;
+    }
+  }
+
+  // 32 bit unsigned subtraction, so this is still right when micros() rolls over (every ~71 minutes)
+  uint32_t currentMicros = micros();
+  uint32_t elapsed_time = currentMicros - _prevMicros;
+  if(elapsed_time >= _sampleIntervalUs){
+    double dt = (currentMicros - _lastSampleMicros)/1000000.0;
+    _actualTime += dt;
+    _lastSampleMicros = currentMicros;
+    // stay on the sample grid if we are only a little late, otherwise start again from now
+    if(elapsed_time < 2*_sampleIntervalUs){
+      _prevMicros += _sampleIntervalUs;
+    }else{
+      _prevMicros = currentMicros;
+    }
     
-    if(controller.programMode == SIMPLE){
-      double temperature = getTemperature();
-      webserverPushData("temperature", temperature);
-      if(controller.state == OFF){
-        controller.triac.disable();
-        controller.fan.off();
-      }else if(controller.state == HOLD){
-        controller.fan.on();
-        double output = myPID.compute(temperature);
-       webserverPushData("duty_cycle", output);
-        triac.duty_cycle = output;
-        triac.enable();
-        webserverPushDatapoint(_actualTime, myPID.getSetpoint(), output, temperature);
-      }else{
+    double temperature = getTemperature();
+    if(thermocouple.getFault() != _reportedFault){
+      ControllerEvent event;
+      event.type = EVENT_FAULT;
+      event.fault.fault = thermocouple.getFault();
+      event.fault.count = thermocouple.getFaultCount();
+      if(publishEvent(event)){
+        _reportedFault = event.fault.fault;
+      }
+    }
+    // keep the estimator tracking all the time, so it has settled by the time we start
+    // the heater power is what was applied over the interval that just finished
+    if(thermocouple.isValid()){
+      double power = triac.isEnabled() ? triac.getDutyCycle()/100 : 0;
+      estimator.update(temperature, power, dt);
+    }
+    double controlTemperature = getControlTemperature();
+
+    // move the setpoint on, and the state with it in program mode
+    if(programMode == SIMPLE){
+      if(state == HOLD){
+        rampSetpoint(dt);
+      }else if(state != OFF){
         //Error: unexpected state
-        String error_msg = String("Error - unexpected state: ") + String(controller.state);
-        Serial.println(error_msg);
-        webserverLog(error_msg);
+        LOG_ERROR("Unexpected state: %d", state);
         controller = Controller(TRIAC_PIN, FAN_PIN, SAMPLE_INTERVAL);
+        return;
       }
+    }else if(programMode == PROGRAM){
+      runProgram(controlTemperature, dt);
     }else{
       //error reset the controller
-      String error_msg = String("Error - unknown programMode: ") + String(controller.programMode);
-      Serial.println(error_msg);
-      webserverLog(error_msg);
+      LOG_ERROR("Unknown programMode: %d", programMode);
       controller = Controller(TRIAC_PIN, FAN_PIN, SAMPLE_INTERVAL);
+      return;
+    }
+
+    // while the PID is running the datapoint carries the temperature, otherwise it goes on its own
+    if(!isHeating() || !thermocouple.isValid()){
+      ControllerEvent event;
+      event.type = EVENT_TEMPERATURE;
+      event.temperature.measured = temperature;
+      event.temperature.estimated = estimatorMode == ESTIMATOR_KALMAN ? controlTemperature : NAN;
+      publishEvent(event);
+    }
+    if(state == OFF){
+      triac.disable();
+      fan.off();
+    }else if(state == COOLING){
+      // fan only, until the roaster is cool enough to leave
+      fan.on();
+      triac.disable();
+      if(thermocouple.isValid() && temperature < SAFE_TEMP){
+        LOG_INFO("Cooled down");
+        state = OFF;
+      }
+    }else if(!thermocouple.isValid()){
+      // no temperature to control with. Keep the fan going to cool down, but no heat.
+      fan.on();
+      triac.disable();
+    }else{
+      fan.on();
+      double output = myPID.compute(controlTemperature);
+      triac.setDutyCycle(output);
+      triac.enable();
+      ControllerEvent event;
+      event.type = EVENT_SAMPLE;
+      event.sample.timestamp = (uint32_t)(_actualTime*1000 + 0.5);
+      event.sample.setpoint = myPID.getSetpoint();
+      event.sample.output = output;
+      event.sample.temperature = temperature;
+      publishEvent(event);
     }
   }
-  triac.process();
   return;
 }
 
+/*
+ * Simple mode: move the PID setpoint towards the setpoint that was asked for, at ramp_rate
+ */
+void Controller::rampSetpoint(double dt){
+  double setpoint = myPID.getSetpoint();
+  double step = ramp_rate/60*dt;
+  if(ramp_rate <= 0 || fabs(_targetSetpoint - setpoint) <= step){
+    setpoint = _targetSetpoint;
+  }else{
+    setpoint += _targetSetpoint > setpoint ? step : -step;
+  }
+  myPID.setSetpoint(setpoint);
+}
+
+/*
+ * Program mode state machine, once per sample
+ *  PREHEATING: heat to the profile's preheat temperature, PREHEAT once it is within PREHEAT_BAND
+ *  PREHEAT:    hold it until start() (the beans are in), or cool down if that takes over MAX_PREHEAT_TIME
+ *  RAMPING/HOLD: follow the profile, whichever its current segment is doing, then COOLING at the end
+ * COOLING and OFF are handled in process(), the same as simple mode.
+ */
+void Controller::runProgram(double temperature, double dt){
+  switch(state){
+    case PREHEATING:
+      myPID.setSetpoint(profile.getPreheat());
+      if(thermocouple.isValid() && temperature >= profile.getPreheat() - PREHEAT_BAND){
+        LOG_INFO("Preheated to %.1f oC, add the beans and start", temperature);
+        state = PREHEAT;
+        _preheatTime = 0;
+      }
+      break;
+    case PREHEAT:
+      _preheatTime += dt;
+      if(_preheatTime > MAX_PREHEAT_TIME){
+        LOG_WARN("Not started within %d s of preheating, cooling down", MAX_PREHEAT_TIME);
+        state = COOLING;
+      }
+      break;
+    case RAMPING:
+    case HOLD:
+      myPID.setSetpoint(profile.advance(dt));
+      if(profile.done()){
+        LOG_INFO("Program finished, cooling down");
+        state = COOLING;
+      }else{
+        state = profile.currentKind() == SEGMENT_RAMP ? RAMPING : HOLD;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+/*
+ * Set how often the controller samples the thermocouple and runs the PID [ms]
+ * SAMPLE_INTERVAL by default, down to FAST_SAMPLE_INTERVAL (the thermocouple can't convert any faster)
+ */
+void Controller::setSampleInterval(unsigned long sampleInterval){
+  if(sampleInterval < MIN_SAMPLE_INTERVAL){
+    sampleInterval = MIN_SAMPLE_INTERVAL;
+  }
+  _sampleIntervalUs = sampleInterval*1000;
+}
+
+unsigned long Controller::getSampleInterval(){
+  return(_sampleIntervalUs/1000);
+}
+
+/*
+ * The latest filtered temperature. Doesn't read the thermocouple, that is done on its own schedule in process().
+ * NAN if there hasn't been a good reading recently.
+ */
 double Controller::getTemperature(){
-  return(thermocouple.readCelsius());
+  return(thermocouple.getTemperature());
+}
+
+/*
+ * The temperature the PID controls on: the estimated bean temperature if the estimator is on,
+ * otherwise the measured one
+ */
+double Controller::getControlTemperature(){
+  if(estimatorMode == ESTIMATOR_KALMAN && thermocouple.isValid()){
+    return(estimator.getTemperature());
+  }
+  return(getTemperature());
+}
+
+void Controller::setEstimatorMode(EstimatorMode mode){
+  estimatorMode = mode;
 }
 
+EstimatorMode Controller::getEstimatorMode(){
+  return(estimatorMode);
+}
+
+/*
+ * The simple mode setpoint. While running with a ramp rate the PID setpoint ramps to it from process().
+ * In program mode the profile sets the PID setpoint, this is kept for going back to simple mode.
+ */
 void Controller::setSetpoint(double setpoint){
-  myPID.setSetpoint(setpoint);
+  _targetSetpoint = setpoint;
+  if(programMode == SIMPLE && (ramp_rate <= 0 || state != HOLD)){
+    myPID.setSetpoint(setpoint);
+  }
 }
 double Controller::getSetpoint(void){
-  return(myPID.getSetpoint());
+  return(programMode == SIMPLE ? _targetSetpoint : myPID.getSetpoint());
 }
 
 
+/*
+ * Simple mode: run the PID at the setpoint (ramping to it from the current temperature if there is a ramp rate)
+ * Program mode: the beans are in, start the profile. Only once it has started preheating.
+ */
 void Controller::start(){
+  if(programMode == PROGRAM){
+    if(state != PREHEATING && state != PREHEAT){
+      LOG_WARN("Preheat before starting the program");
+      return;
+    }
+    LOG_INFO("Starting program %s (%.0f s)", profile.getName(), profile.duration());
+    profile.begin();
+    myPID.setSetpoint(profile.getSetpoint());
+    state = profile.done() ? COOLING : (profile.currentKind() == SEGMENT_RAMP ? RAMPING : HOLD);
+    return;
+  }
   if(state != HOLD){
     myPID.reset();
+    myPID.setSetpoint(ramp_rate > 0 && thermocouple.isValid() ? getControlTemperature() : _targetSetpoint);
     state = HOLD;
     _actualTime = 0;
-    _prevMillis = millis();
+    _prevMicros = micros();
+    _lastSampleMicros = _prevMicros;
   }
 }
 
+/*
+ * Simple mode turns everything off. Program mode aborts the roast and cools down, stopping again while
+ * cooling turns the fan off as well.
+ */
 void Controller::stop(){
-  if(state != OFF){
+  if(programMode == PROGRAM && isHeating()){
+    state = COOLING;
+  }else if(state != OFF){
     state = OFF;
   }
 }
@@ -106,6 +300,50 @@ void Controller::restart(){
   start();
 }
 
+/*
+ * Program mode: heat up to the profile's preheat temperature, ready for the beans
+ */
+bool Controller::preheat(){
+  if(programMode != PROGRAM || (state != OFF && state != COOLING)){
+    LOG_WARN("Can only preheat in program mode, when stopped");
+    return(false);
+  }
+  if(profile.segmentCount() == 0){
+    LOG_WARN("No program loaded");
+    return(false);
+  }
+  myPID.reset();
+  myPID.setSetpoint(profile.getPreheat());
+  state = PREHEATING;
+  _preheatTime = 0;
+  _actualTime = 0;
+  _prevMicros = micros();
+  _lastSampleMicros = _prevMicros;
+  return(true);
+}
+
+/*
+ * Switch between simple and program mode, only when stopped
+ */
+bool Controller::setProgramMode(ProgramMode mode){
+  if(mode != programMode && state != OFF){
+    LOG_WARN("Stop the roaster before changing mode");
+    return(false);
+  }
+  programMode = mode;
+  if(mode == SIMPLE){
+    myPID.setSetpoint(_targetSetpoint);
+  }
+  return(true);
+}
+
+/*
+ * Whether the PID is running the heater (or would be, with a good temperature)
+ */
+bool Controller::isHeating(){
+  return(state == PREHEATING || state == PREHEAT || state == RAMPING || state == HOLD);
+}
+
 
 // Set/Get PID parameters
 void Controller::setP(double p){
@@ -128,79 +366,46 @@ double Controller::getD(){
   return(myPID.getD());
 }
 
-bool Controller::loadConfig(){
-  Serial.println("Loading config");
-  if(!SPIFFS.exists("/"+config_filename)){
-    Serial.println("  Config file doesn't exist");
-    return(true);
-  }
-
-  File configFile = SPIFFS.open("/"+config_filename, "r");
-  if (!configFile) {
-    Serial.println("  Failed to open config file");
-    return false;
+/*
+ * Schedule the PID gains on the setpoint (see mypid.h): each band is {temperature, p, i, d}, temperatures going up.
+ * One band is fixed gains. Returns false (and changes nothing) if the bands don't make sense.
+ * setP()/setI()/setD() set every band.
+ */
+bool Controller::setGainSchedule(uint8_t bands, const double schedule[][GAIN_BAND_FIELDS]){
+  if(bands < 1 || bands > PID_MAX_BANDS){
+    return(false);
   }
-
-  // Allocate a buffer to store contents of the file and read it in
-  size_t size = configFile.size();
-  std::unique_ptr<char[]> buf(new char[size]);
-  configFile.readBytes(buf.get(), size);
-  configFile.close();
-
-  // parse it
-  StaticJsonBuffer<200> jsonBuffer;
-  JsonObject& json = jsonBuffer.parseObject(buf.get());
-
-  if (!json.success()) {
-    Serial.println("Failed to parse config file");
-    return false;
-  }
-
-  if(json.containsKey("p")){
-    setP(json["p"]);
-  }
-  if(json.containsKey("i")){
-    setI(json["i"]);
+  for(uint8_t b=0; b<bands; b++){
+    for(uint8_t f=0; f<GAIN_BAND_FIELDS; f++){
+      // gains no more than the p/i/d parameters allow (PID_MAX_GAIN)
+      if(!(schedule[b][f] >= 0 && schedule[b][f] <= (f == 0 ? 1000 : PID_MAX_GAIN))){
+        return(false);
+      }
+    }
+    if(b > 0 && schedule[b][0] <= schedule[b - 1][0]){
+      return(false);
+    }
   }
-  if(json.containsKey("d")){
-    setD(json["d"]);
+  for(uint8_t b=0; b<bands; b++){
+    myPID.setBandTemperature(b, schedule[b][0]);
+    myPID.setP(schedule[b][1], b);
+    myPID.setI(schedule[b][2], b);
+    myPID.setD(schedule[b][3], b);
   }
-  return true;
+  myPID.setBands(bands);
+  return(true);
 }
 
-
-bool Controller::saveConfig(){
-  Serial.println("Saving Config");
-
-  Serial.println("  Creating JSON object");
-  StaticJsonBuffer<200> jsonBuffer;
-  JsonObject& json = jsonBuffer.createObject();
-  json["p"] = myPID.getP();
-  json["i"] = myPID.getI();
-  json["d"] = myPID.getD();
-
-  if(SPIFFS.exists("/"+config_filename)){
-    Serial.println("   Config file already exists. Deleting old one first");
-    SPIFFS.remove("/"+config_filename);
-  }
-
-  Serial.println("   Opening the config file");
-  File configFile = SPIFFS.open("/"+config_filename, "w");
-  if (!configFile) {
-    Serial.println("Failed to open config file for writing");
-    return false;
+/*
+ * The gain schedule, returns how many bands it has
+ */
+uint8_t Controller::getGainSchedule(double schedule[][GAIN_BAND_FIELDS]){
+  uint8_t bands = myPID.getBands();
+  for(uint8_t b=0; b<bands; b++){
+    schedule[b][0] = myPID.getBandTemperature(b);
+    schedule[b][1] = myPID.getP(b);
+    schedule[b][2] = myPID.getI(b);
+    schedule[b][3] = myPID.getD(b);
   }
-
-  Serial.println("   Writing the config file");
-  json.printTo(Serial);
-  Serial.println("");
-  if(json.printTo(configFile) == 0){
-    Serial.println("    Failed to write to file");
-  }
-
-  Serial.println("   Closing the config file");
-  configFile.close();
-
-  Serial.println("   Done");
-  return true;
+  return(bands);
 }
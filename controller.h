@@ -6,19 +6,28 @@
 #ifndef CONTROLLER_H
 #define CONTROLLER_H
 #include <Arduino.h>
-#include <SPI.h>
-#include "Adafruit_MAX31855.h"
+#include "thermocouple.h"
 #include "triacOutput.h"
 #include "fan.h"
 #include "mypid.h"
+#include "estimator.h"
+#include "roastProfile.h"
 
 
-#define MAX_PREHEAT_TIME 120
-#define SAFE_TEMP 30
+#define MAX_PREHEAT_TIME 120  // how long to wait at the preheat temperature for the beans to go in [s]
+#define PREHEAT_BAND 5         // preheat is reached within this much of the preheat temperature [oC]
+#define SAFE_TEMP 30           // cooling down finishes below this [oC]
 
 #define FAN_PIN D3
 #define TRIAC_PIN D2
-#define SAMPLE_INTERVAL 2000
+#define SAMPLE_INTERVAL 2000      // default sample interval [ms]
+#define FAST_SAMPLE_INTERVAL 100  // the MAX31855 conversion time [ms]
+#define MIN_SAMPLE_INTERVAL 100
+#define TRIAC_DRIVE TRIAC_TIMER
+#define TRIAC_DISTRIBUTION TRIAC_BURST
+#define ESTIMATOR_MODE ESTIMATOR_OFF  // control on the measured temperature by default
+#define NOT_REPORTED 0xFF
+#define GAIN_BAND_FIELDS 4        // a gain schedule band is temperature [oC], p, i, d
 
 enum ProgramMode {SIMPLE, PROGRAM};
 enum State {OFF, PREHEATING, PREHEAT, RAMPING, HOLD, COOLING};
@@ -27,15 +36,24 @@ class Controller{
   public:
     ProgramMode programMode;
     State state;
-    double ramp_rate;
-    unsigned long _prevMillis;
-    unsigned long _sampleInterval;
-    unsigned long _actualTime;
+    double ramp_rate;                // simple mode setpoint changes ramp at this [oC/min], 0 to step
+    double _targetSetpoint;          // simple mode setpoint the PID setpoint is ramping to
+    double _preheatTime;             // time spent waiting at the preheat temperature [s]
+    uint32_t _prevMicros;            // start of the current sample interval
+    uint32_t _lastSampleMicros;      // when the last sample was actually taken
+    unsigned long _sampleIntervalUs;
+    double _actualTime;  // time since start [s]
+    uint8_t _reportedFault;  // thermocouple fault flags last published
+    uint8_t _reportedState;  // state and program mode last published, NOT_REPORTED before the first
+    uint8_t _reportedMode;
+    EstimatorMode estimatorMode;
     
-    Adafruit_MAX31855 thermocouple;
+    Thermocouple thermocouple;
     TriacOutput triac;
     Fan fan;
     PID myPID;
+    TemperatureEstimator estimator;
+    RoastProfile profile;
 
     Controller(uint8_t triac_pin, uint8_t fan_pin, unsigned long sampleInterval);
     
@@ -43,8 +61,18 @@ class Controller{
     void start();
     void stop();
     void restart();
+    bool preheat();
+    bool setProgramMode(ProgramMode mode);
+    bool isHeating();
 
     double getTemperature();
+    double getControlTemperature();
+
+    void setEstimatorMode(EstimatorMode mode);
+    EstimatorMode getEstimatorMode();
+
+    void setSampleInterval(unsigned long sampleInterval);
+    unsigned long getSampleInterval();
 
     void setSetpoint(double setpoint);
     double getSetpoint();
@@ -56,9 +84,16 @@ class Controller{
     double getP();
     double getI();
     double getD();
+
+    bool setGainSchedule(uint8_t bands, const double schedule[][GAIN_BAND_FIELDS]);
+    uint8_t getGainSchedule(double schedule[][GAIN_BAND_FIELDS]);
     
     bool loadConfig();
     bool saveConfig();
+
+  private:
+    void rampSetpoint(double dt);
+    void runProgram(double temperature, double dt);
 };
 
 extern Controller controller;
@@ -0,0 +1,117 @@
+/*
+ * Controller config persistence
+ * Load/save the controller settings as JSON in SPIFFS: the parameters flagged PARAM_PERSIST in params.cpp,
+ * and the PID gain schedule as "gain_schedule":[[temperature, p, i, d], ...] when it has more than one band.
+ * Kept separate from controller.cpp so the control code doesn't depend on the filesystem
+ * or ArduinoJson (the host build compiles controller.cpp without them).
+ */
+#include <FS.h>
+#include <ArduinoJson.h>
+#include "controller.h"
+#include "params.h"
+#include "logger.h"
+
+
+String config_filename = String("config.json");
+
+// room for the gain schedule on top of the parameters
+#define CONFIG_JSON_SIZE (400 + JSON_ARRAY_SIZE(PID_MAX_BANDS) + PID_MAX_BANDS*JSON_ARRAY_SIZE(GAIN_BAND_FIELDS))
+
+
+bool Controller::loadConfig(){
+  LOG_INFO("Loading config");
+  if(!SPIFFS.exists("/"+config_filename)){
+    LOG_INFO("Config file doesn't exist");
+    return(true);
+  }
+
+  File configFile = SPIFFS.open("/"+config_filename, "r");
+  if (!configFile) {
+    LOG_ERROR("Failed to open config file");
+    return false;
+  }
+
+  // Allocate a buffer to store contents of the file and read it in
+  size_t size = configFile.size();
+  std::unique_ptr<char[]> buf(new char[size]);
+  configFile.readBytes(buf.get(), size);
+  configFile.close();
+
+  // parse it
+  StaticJsonBuffer<CONFIG_JSON_SIZE> jsonBuffer;
+  JsonObject& json = jsonBuffer.parseObject(buf.get());
+
+  if (!json.success()) {
+    LOG_ERROR("Failed to parse config file");
+    return false;
+  }
+
+  const ParamDef *defs = paramDefs();
+  for(uint8_t i=0; i<paramCount(); i++){
+    if((defs[i].flags & PARAM_PERSIST) && json.containsKey(defs[i].name)){
+      paramSet(i, json[defs[i].name].as<double>());
+    }
+  }
+  // after p/i/d, which set every band
+  if(json.containsKey("gain_schedule")){
+    JsonArray& bands = json["gain_schedule"];
+    double schedule[PID_MAX_BANDS][GAIN_BAND_FIELDS];
+    uint8_t count = 0;
+    for(const auto& band: bands){
+      if(count >= PID_MAX_BANDS){
+        count = 0;
+        break;
+      }
+      for(uint8_t f=0; f<GAIN_BAND_FIELDS; f++){
+        schedule[count][f] = band[f].as<double>();
+      }
+      count++;
+    }
+    if(!setGainSchedule(count, schedule)){
+      LOG_ERROR("Bad gain schedule in the config file");
+    }
+  }
+  return true;
+}
+
+
+bool Controller::saveConfig(){
+  LOG_INFO("Saving config");
+
+  StaticJsonBuffer<CONFIG_JSON_SIZE> jsonBuffer;
+  JsonObject& json = jsonBuffer.createObject();
+  const ParamDef *defs = paramDefs();
+  for(uint8_t i=0; i<paramCount(); i++){
+    if(defs[i].flags & PARAM_PERSIST){
+      json[defs[i].name] = paramGet(i);
+    }
+  }
+  double schedule[PID_MAX_BANDS][GAIN_BAND_FIELDS];
+  uint8_t bands = getGainSchedule(schedule);
+  if(bands > 1){
+    JsonArray& jsonBands = json.createNestedArray("gain_schedule");
+    for(uint8_t b=0; b<bands; b++){
+      JsonArray& band = jsonBands.createNestedArray();
+      for(uint8_t f=0; f<GAIN_BAND_FIELDS; f++){
+        band.add(schedule[b][f]);
+      }
+    }
+  }
+
+  if(SPIFFS.exists("/"+config_filename)){
+    LOG_DEBUG("Config file already exists. Deleting old one first");
+    SPIFFS.remove("/"+config_filename);
+  }
+
+  File configFile = SPIFFS.open("/"+config_filename, "w");
+  if (!configFile) {
+    LOG_ERROR("Failed to open config file for writing");
+    return false;
+  }
+
+  if(json.printTo(configFile) == 0){
+    LOG_ERROR("Failed to write the config file");
+  }
+  configFile.close();
+  return true;
+}
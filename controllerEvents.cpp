@@ -0,0 +1,30 @@
+#include "controllerEvents.h"
+
+#ifdef HOST_BUILD
+#define EVENT_STATE_STORAGE static thread_local
+#else
+#define EVENT_STATE_STORAGE static
+#endif
+
+EVENT_STATE_STORAGE ControllerEventQueue events;
+EVENT_STATE_STORAGE uint32_t dropped = 0;
+
+
+ControllerEventQueue &controllerEvents(){
+  return(events);
+}
+
+/*
+ * Queue an event for the web layer, false (and counted) if the queue is full
+ */
+bool publishEvent(const ControllerEvent &event){
+  if(!events.push(event)){
+    dropped++;
+    return(false);
+  }
+  return(true);
+}
+
+uint32_t controllerEventsDropped(){
+  return(dropped);
+}
@@ -0,0 +1,49 @@
+/*
+ * Events from the controller to the web layer
+ * The controller doesn't call into the web server. Each sample it publishes fixed size events into a lock-free
+ * single producer/single consumer ring (spscRing.h), and webserverProcess() takes them out and deals with them
+ * (batching datapoints, status changes, log lines) at its own pace. Publishing is a copy of 20 bytes, so
+ * process() costs the same whoever is connected, and could be moved into a timer interrupt.
+ *
+ * The controller is the only producer: every event comes from Controller::process(), including state changes,
+ * which it notices rather than start()/stop() publishing them (those are called from the web layer).
+ * If the ring is full the event is dropped and counted.
+ * On the host each thread has its own queue, like the rest of the host hal.
+ */
+#ifndef CONTROLLEREVENTS_H
+#define CONTROLLEREVENTS_H
+
+#include <stdint.h>
+#include "dataFrame.h"
+#include "spscRing.h"
+
+#define CONTROLLER_EVENTS 32   // power of 2, 3 s of events at the fastest sample interval
+
+enum ControllerEventType {EVENT_SAMPLE, EVENT_TEMPERATURE, EVENT_STATE, EVENT_FAULT};
+
+struct ControllerEvent {
+  uint8_t type;
+  union {
+    DatapointFrame sample;    // EVENT_SAMPLE: a PID step
+    struct {
+      float measured;
+      float estimated;        // NAN when the estimator is off
+    } temperature;            // EVENT_TEMPERATURE: a sample while the PID isn't running
+    struct {
+      uint8_t state;
+      uint8_t programMode;
+    } state;                  // EVENT_STATE: the state or program mode changed
+    struct {
+      uint8_t fault;          // MAX31855 fault flags, 0 when it clears
+      uint32_t count;         // faults so far
+    } fault;                  // EVENT_FAULT: the thermocouple fault flags changed
+  };
+};
+
+typedef SpscRing<ControllerEvent, CONTROLLER_EVENTS> ControllerEventQueue;
+
+ControllerEventQueue &controllerEvents(void);
+bool publishEvent(const ControllerEvent &event);
+uint32_t controllerEventsDropped(void);
+
+#endif  // CONTROLLEREVENTS_H
@@ -6,25 +6,29 @@
 
   == Simple interface ==
   - Set PID parameters
-  - Set setpoint temperature and target ramp rate
+  - Set setpoint temperature and target ramp rate [oC/min] (0 to step straight to the setpoint)
   - Start/Stop the roaster
 
   Status on the RHS is updated whenever anything changes (tempreature periodically)
   A chart with the setpoint, measured temp and output are displayed when you press start, updated in real time
 
   == Program interface ==
-  Not implemented yet
   Program in a full ramp profile and set the roaster to follow it.
-  program is a JSON file with settings and ramp-rates/setoints
-  eg:
-  {preheat_temp: 120, 
-  ramp_rate: 200,
-  hold_temp: 320, 
-  hold_Time: 120,
-  p: 10,
-  i: 0,
-  d: 0
-  }
+  The profile is a preheat temperature and up to 8 steps, each ramping to a target temperature at a ramp
+  rate [oC/min] (0 to go straight there) then holding it for a hold time [s]:
+  {"program":{"program_name":"city", "preheat_temp":150,
+              "program_steps":[{"step_name":"dry", "target_temp":200, "ramp_rate":30, "hold_time":60}, ...]}}
+  Then "preheat" heats to the preheat temperature (state PREHEATING, then PREHEAT), "start" once the beans
+  are in runs the steps (RAMPING/HOLD, "program_segment" is how far it has got), and at the end, or on "stop",
+  it cools down with the fan (COOLING) until it is below 30 oC. If it isn't started within 2 minutes
+  of reaching the preheat temperature it cools down.
+  The mode can only be changed ("simple_mode"/"program_mode") when the roaster is off.
+
+  == PID gain schedule ==
+  {"gain_schedule":[[temperature, p, i, d], ...]} uses different gains at different setpoints (up to 4 bands, gains up to 100,
+  temperatures going up), interpolated in between, eg. harder in the slow drying phase than after first crack.
+  One band is fixed gains. Setting p, i or d sets it in every band, and the status p, i and d are the gains
+  in effect now ("gain_bands" is how many there are). "saveConfig" saves the schedule with the rest.
 
 
   == Structure ==
@@ -32,7 +36,9 @@
   Data is send/received as JSON
 
   When the websocket is opened, the server will send the current status in full.
-  Whenever anything changes on the server, it will send only the parameters which have changed.
+  Whenever anything changes on the server, it will send only the parameters which have changed, to every
+  client (checked every 250 ms, and straight after each message from a client - there is no separate reply).
+  Temperatures only count as changed once they have moved by 0.25 oC, the duty cycle by 0.1%.
   This client should listen to all messages and update the display as they are received. No need to poll.
 
   Data is sent one datapoint at a time from the server as it is measured.
@@ -47,12 +53,46 @@
   "data": ["p":10, "i":1, "d":0, "filename":"temp.csv"]}
 
 
-  === Datapoint from the server ===
-  {"type":"data",
-  "data":"timestamp,setpoint,output,temperature"}
+  === Datapoints from the server ===
+  Datapoints are batched, one or more per message, separated by ;
+  seq is the sequence number of the first one, the rest follow on from it.
+  {"type":"data", "seq":N,
+  "data":"timestamp,setpoint,output,temperature;timestamp,setpoint,output,temperature"}
   eg.
-  {"type":"data",
-  "data":"123456789,125,75,103"}
+  {"type":"data", "seq":6,
+  "data":"12.000,125,75,103;14.000,125,74,104"}
+  While the controller is running the temperature and duty cycle are only sent in the datapoints.
+
+  === Resuming ===
+  The server keeps the datapoints for the current roast. On (re)connecting the client sends
+  {"resume":next_seq} with the sequence number after the last datapoint it has (0 for none), and the
+  server sends everything from there on, a chunk at a time, before carrying on with the live datapoints.
+  With {"resume":next_seq, "points":N} what the server already has is downsampled to N points first
+  (so a long roast doesn't take ages to load). Those messages have "next":seq instead of "seq",
+  the sequence number to carry on from.
+
+  === Subscriptions ===
+  A client gets the samples (datapoints), status and log topics at every update unless it asks otherwise:
+  {"subscribe":{"topic":rate, ...}} gets each topic at no more than rate [Hz] (0 = every update)
+  {"unsubscribe":["topic", ...]}
+  Log lines (level error, warn, info or debug) are {"type":"log", "level":"warn", "data":"Thermocouple fault: 1"}
+  Topics are samples, status, logs and diagnostics (server counters, once a second at "every update"):
+  {"type":"diagnostics", "data":{"param":value, ...},
+   "stages":{"controller":{"count":n, "p50":us, "p99":us, "max":us, "overruns":n}, ...},
+   "tasks":{"control":{"runs":n, "late_p99":us, "late_max":us, "misses":n}, ...}}
+  with how long each stage of the main loop takes (and how late the triac output runs), and how late each
+  scheduler task started and how often it missed its deadline. The same is served
+  as Prometheus metrics at /metrics, and the "reset_metrics" command clears the loop timings.
+  Samples at a limited rate come as decimated messages ("next":seq). A status at a limited rate has everything
+  which changed since the last one.
+  This page subscribes from its query string, eg. temperature.html?status=1&samples=0.5 for a wall display.
+
+  === Binary datapoints ===
+  After sending {"commands":["binary_data"]} the server sends datapoints as binary messages instead
+  (see dataFrame.h), little-endian:
+    type 2 = datapoints: uint8 version, uint8 type, uint16 count, uint32 seq, then count records
+    type 3 = decimated:  the same as type 2, but the uint32 is the sequence number to carry on from
+    record: uint32 timestamp [ms], float32 setpoint, float32 output, float32 temperature
 
 */
 
@@ -62,6 +102,15 @@ var states = ["OFF", "PREHEATING", "PREHEAT", "RAMPING", "HOLD", "COOLING"]
 
 var t0 = -1;
 
+var last_timestamp = -1;
+var next_seq = 0;        // sequence number of the next datapoint we expect
+
+var FRAME_VERSION = 2;
+var FRAME_DATAPOINTS = 2;
+var FRAME_DECIMATED = 3;
+
+var HISTORY_POINTS = 500;  // how many points to ask for when loading the history
+
 var timerPointer;
 var myChart;
 
@@ -69,6 +118,10 @@ var myChart;
  * Callback function when a websocket message is received from the server
  */
 websocket_message = function (e) {
+    if(e.data instanceof ArrayBuffer){
+        binary_message(e.data);
+        return;
+    }
     console.log('Message received: <', e.data, '>');
     var msg;
     try{
@@ -110,6 +163,12 @@ websocket_message = function (e) {
                 }else if (key == "d"){
                     document.getElementById("status_D").innerHTML = "D = " + data[key];
                     document.getElementById("setpoint_D").value = data[key];
+                }else if (key == "sample_interval"){
+                    document.getElementById("setpoint_sample_interval").value = data[key];
+                }else if (key == "history_span"){
+                    document.getElementById("status_history_span").innerHTML = "History = " + (data[key]/60).toFixed(1) + " min";
+                }else if (key == "thermocouple_fault"){
+                    document.getElementById("status_tc_fault").innerHTML = "Thermocouple = " + thermocouple_fault_text(data[key]);
                 }else if (key == "filename"){
                     filename = data[key];
                 }
@@ -117,36 +176,132 @@ websocket_message = function (e) {
             }
         }
     }else if(msg.type == "data"){
-        var data = msg.data.split(",", 4);
-        if(t0 < 0){
-            t0 = parseInt(data[0]);
+        var samples = msg.data.split(";");
+        if(msg.next !== undefined){
+            next_seq = msg.next;
+        }else{
+            next_seq = msg.seq + samples.length;
+        }
+        for(var i = 0; i < samples.length; i++){
+            var data = samples[i].split(",", 4);
+            add_datapoint(parseFloat(data[0]), parseFloat(data[1]), parseFloat(data[2]), parseFloat(data[3]));
         }
-        var timestamp = parseInt(data[0]) - t0;
-        myChart.data.datasets[0].data.push({x: timestamp, y: parseFloat(data[3])});
-        myChart.data.datasets[1].data.push({x: timestamp, y: parseFloat(data[1])});
-        myChart.data.datasets[2].data.push({x: timestamp, y: parseFloat(data[2])});
-        //setpoints.push({x: timestamp, y: parseFloat(data[1])});
-        //outputs.push({x: timestamp, y: parseFloat(data[2])});
-        //temperatures.push({x: timestamp, y: parseFloat(data[3])});
-        //drawChart();
+        update_datapoint_status(parseFloat(data[2]), parseFloat(data[3]));
         myChart.update();
+    }else if(msg.type == "log"){
+        console.log(msg.level + ": " + msg.data);
+    }else if(msg.type == "diagnostics"){
+        console.log(msg.type + ": ", msg.data);
     }else{
         console.log("Unhandled message type");
     }
 }
 
 
+/*
+ * Decode a binary message from the server
+ */
+function binary_message(buffer) {
+    var view = new DataView(buffer);
+    if(view.byteLength < 2 || view.getUint8(0) != FRAME_VERSION){
+        console.log("Unknown binary frame");
+        return;
+    }
+    var type = view.getUint8(1);
+    var count = 0;
+    var header = 8;
+    if(type == FRAME_DATAPOINTS && view.byteLength >= header){
+        count = view.getUint16(2, true);
+        next_seq = view.getUint32(4, true) + count;
+    }else if(type == FRAME_DECIMATED && view.byteLength >= header){
+        count = view.getUint16(2, true);
+        next_seq = view.getUint32(4, true);
+    }
+    if(count > 0 && view.byteLength >= header + 16*count){
+        for(var i = 0; i < count; i++){
+            var offset = header + 16*i;
+            add_datapoint(view.getUint32(offset, true)/1000,
+                          view.getFloat32(offset + 4, true),
+                          view.getFloat32(offset + 8, true),
+                          view.getFloat32(offset + 12, true));
+        }
+        update_datapoint_status(view.getFloat32(offset + 8, true), view.getFloat32(offset + 12, true));
+        myChart.update();
+    }else{
+        console.log("Unhandled binary frame type");
+    }
+}
+
+
+/*
+ * Add a datapoint to the chart. timestamp [s]
+ * Call myChart.update() after adding a batch
+ * If the time goes backwards the roast was restarted (maybe while we were disconnected), so start a new chart.
+ */
+function add_datapoint(timestamp, setpoint, output, temperature) {
+    if(timestamp < last_timestamp){
+        t0 = -1;
+        for(var i = 0; i < myChart.data.datasets.length; i++){
+            myChart.data.datasets[i].data = [];
+        }
+    }
+    last_timestamp = timestamp;
+    if(t0 < 0){
+        t0 = timestamp;
+    }
+    timestamp = timestamp - t0;
+    myChart.data.datasets[0].data.push({x: timestamp, y: temperature});
+    myChart.data.datasets[1].data.push({x: timestamp, y: setpoint});
+    myChart.data.datasets[2].data.push({x: timestamp, y: output});
+}
+
+/*
+ * Show the latest datapoint in the status, the server doesn't send them separately while running
+ */
+function update_datapoint_status(output, temperature) {
+    document.getElementById("status_temp").innerHTML = "Temp = " + temperature.toFixed(2);
+    document.getElementById("status_duty_cycle").innerHTML = "duty_cycle = " + output.toFixed(2);
+}
+
+
 
 /*
  * Main init funciton. Opens a websocket connection to the server and then everything is event driven after that
- * It would be nice to reconnect to the server if the socket is dropped for some reason.
  */
 function init() {
     myChart = drawChart();
-    
+    connect();
+}
+
+/*
+ * Topic subscriptions from the page's query string, eg. ?status=1&samples=0.5 (rates in Hz)
+ */
+function subscriptions() {
+    var topics = {};
+    var query = new URLSearchParams(location.search);
+    ["samples", "status", "logs", "diagnostics"].forEach(function(topic) {
+        if(query.has(topic)){
+            topics[topic] = parseFloat(query.get(topic)) || 0;
+        }
+    });
+    return topics;
+}
+
+/*
+ * Open the websocket. If it drops, keep trying to reconnect, and pick up the datapoints from where we left off.
+ */
+function connect() {
     connection = new WebSocket('ws://'+location.host+':81/', ['arduino']);
+    connection.binaryType = "arraybuffer";
     connection.onopen = function () {
         console.log('new connection');
+        // ask for the compact binary datapoints, and anything we missed
+        var msg = {commands: ["binary_data"], resume: next_seq, points: HISTORY_POINTS};
+        var topics = subscriptions();
+        if(Object.keys(topics).length > 0){
+            msg.subscribe = topics;
+        }
+        connection.send(JSON.stringify(msg));
     };
     connection.onmessage = websocket_message;
 
@@ -156,6 +311,7 @@ function init() {
 
     connection.onclose = function () {
         console.log('WebSocket connection closed');
+        setTimeout(connect, 2000);
     };
 }
 
@@ -274,6 +430,23 @@ function change_d() {
     connection.send('{"parameters":{"d":'+d+'}}');
 }
 
+// MAX31855 fault bits
+function thermocouple_fault_text(fault) {
+    if(fault == 0){
+        return "OK";
+    }
+    var faults = [];
+    if(fault & 1){ faults.push("open circuit"); }
+    if(fault & 2){ faults.push("short to GND"); }
+    if(fault & 4){ faults.push("short to VCC"); }
+    return faults.join(", ");
+}
+
+function change_sample_interval() {
+    var sample_interval = String(document.getElementById("setpoint_sample_interval").value)
+    connection.send('{"parameters":{"sample_interval":'+sample_interval+'}}');
+}
+
 function save_config(){
     connection.send('{"commands":["saveConfig"]}');
 }
@@ -311,6 +484,7 @@ document.getElementById("setpoint_ramp_rate").onchange = change_ramp_rate;
 document.getElementById("setpoint_P").onchange = change_p;
 document.getElementById("setpoint_I").onchange = change_i;
 document.getElementById("setpoint_D").onchange = change_d;
+document.getElementById("setpoint_sample_interval").onchange = change_sample_interval;
 document.getElementById("save_config_button").onclick = save_config;
 document.getElementById("simple_restart_button").onclick = restart_controller;
 document.getElementById("simple_start_stop_button").onclick = function() {
@@ -329,6 +503,7 @@ document.getElementById("simple_start_stop_button").onclick = function() {
  * send the program roast profile to the micro and start preheating
  */
 document.getElementById("program_preheat_button").onclick = function() {
+    connection.send('{"commands":["preheat"]}');
     document.getElementById("program_start_button").disabled = false;
     document.getElementById("program_abort_button").disabled = false;
     document.getElementById("program_preheat_button").disabled = true;
@@ -339,6 +514,7 @@ document.getElementById("program_preheat_button").onclick = function() {
  * Preheat is finished, you have added the beans, start the roast
  */
 document.getElementById("program_start_button").onclick = function() {
+    connection.send('{"commands":["start"]}');
     document.getElementById("program_start_button").disabled = true;
 }
 
@@ -346,6 +522,7 @@ document.getElementById("program_start_button").onclick = function() {
  * Finish the roast eary for some reason.
  */
 document.getElementById("program_abort_button").onclick = function() {
+    connection.send('{"commands":["stop"]}');
     document.getElementById("program_preheat_button").disabled = false;
     document.getElementById("program_filename").disabled = false;
     document.getElementById("program_abort_button").disabled = true;
@@ -363,8 +540,8 @@ $(document).ready(function(){
         var new_row = "<tr>";
         new_row += '<td><input class="form-control" type="text" placeholder="step name"></td>';
         new_row += '<td> <input class="form-control" type="number" placeholder="Target Temperature"></td>';
-        new_row += '<td> <input class="form-control" type="number" placeholder="Ramp Rate"></td>';
-        new_row += '<td> <input class="form-control" type="number" placeholder="Hold Time"></td>';
+        new_row += '<td> <input class="form-control" type="number" placeholder="Ramp Rate [oC/min]"></td>';
+        new_row += '<td> <input class="form-control" type="number" placeholder="Hold Time [s]"></td>';
         new_row += '<td> <button type="button" class="close"><span>&times;</span></button></td>';
         new_row += "</tr>"
         $("#program_table").find("tbody").append(new_row);
@@ -392,13 +569,16 @@ $(document).ready(function(){
             var target_temp = row.cells[1].children[0].value;
             var ramp_rate = row.cells[2].children[0].value;
             var hold_time = row.cells[3].children[0].value;
-            program_steps.push({step_name:step_name, target_temp:target_temp, ramp_rate:ramp_rate, hold_time:hold_time});
+            program_steps.push({step_name:step_name, target_temp:parseFloat(target_temp),
+                                ramp_rate:parseFloat(ramp_rate) || 0, hold_time:parseFloat(hold_time) || 0});
         }
-        var data = {program_name:program_name, program_steps:program_steps};
-        var message = {command:"upload_program", data:data};
+        var preheat_temp = parseFloat(document.getElementById("preheat_temp").value);
+        var data = {program_name:program_name, preheat_temp:preheat_temp, program_steps:program_steps};
+        var message = {program:data};
         message_str = JSON.stringify(message);
         console.log(message_str);
-        
+        connection.send(message_str);
+
     });
 });
 
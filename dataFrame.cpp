@@ -0,0 +1,89 @@
+#include "dataFrame.h"
+#include <string.h>
+
+
+static void putU16(uint8_t *p, uint16_t v){
+  p[0] = v & 0xff;
+  p[1] = v >> 8;
+}
+
+static void putU32(uint8_t *p, uint32_t v){
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+  p[2] = (v >> 16) & 0xff;
+  p[3] = v >> 24;
+}
+
+static void putFloat(uint8_t *p, float f){
+  uint32_t v;
+  memcpy(&v, &f, sizeof(v));
+  putU32(p, v);
+}
+
+static uint32_t getU32(const uint8_t *p){
+  return((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static float getFloat(const uint8_t *p){
+  uint32_t v = getU32(p);
+  float f;
+  memcpy(&f, &v, sizeof(f));
+  return(f);
+}
+
+
+static void putRecord(uint8_t *p, const DatapointFrame &point){
+  putU32(p, point.timestamp);
+  putFloat(p + 4, point.setpoint);
+  putFloat(p + 8, point.output);
+  putFloat(p + 12, point.temperature);
+}
+
+static void getRecord(const uint8_t *p, DatapointFrame *point){
+  point->timestamp = getU32(p);
+  point->setpoint = getFloat(p + 4);
+  point->output = getFloat(p + 8);
+  point->temperature = getFloat(p + 12);
+}
+
+
+static size_t encodeMultiFrame(uint8_t *buf, size_t len, uint8_t type, uint32_t seq, const DatapointFrame *points, size_t count){
+  size_t size = DATAPOINTS_HEADER_SIZE + count*DATAPOINT_RECORD_SIZE;
+  if(len < size || count > 0xffff){
+    return(0);
+  }
+  buf[0] = FRAME_VERSION;
+  buf[1] = type;
+  putU16(buf + 2, (uint16_t)count);
+  putU32(buf + 4, seq);
+  for(size_t i=0; i<count; i++){
+    putRecord(buf + DATAPOINTS_HEADER_SIZE + i*DATAPOINT_RECORD_SIZE, points[i]);
+  }
+  return(size);
+}
+
+
+size_t encodeDatapointsFrame(uint8_t *buf, size_t len, uint32_t firstSeq, const DatapointFrame *points, size_t count){
+  return(encodeMultiFrame(buf, len, FRAME_DATAPOINTS, firstSeq, points, count));
+}
+
+
+size_t encodeDecimatedFrame(uint8_t *buf, size_t len, uint32_t nextSeq, const DatapointFrame *points, size_t count){
+  return(encodeMultiFrame(buf, len, FRAME_DECIMATED, nextSeq, points, count));
+}
+
+
+size_t decodeDatapointsFrame(const uint8_t *buf, size_t len, uint32_t *seq, DatapointFrame *points, size_t max){
+  if(len < DATAPOINTS_HEADER_SIZE || buf[0] != FRAME_VERSION || (buf[1] != FRAME_DATAPOINTS && buf[1] != FRAME_DECIMATED)){
+    return(0);
+  }
+  size_t count = (size_t)buf[2] | ((size_t)buf[3] << 8);
+  if(len < DATAPOINTS_HEADER_SIZE + count*DATAPOINT_RECORD_SIZE){
+    return(0);
+  }
+  *seq = getU32(buf + 4);
+  for(size_t i=0; i<count && i<max; i++){
+    getRecord(buf + DATAPOINTS_HEADER_SIZE + i*DATAPOINT_RECORD_SIZE, &points[i]);
+  }
+  return(count);
+}
@@ -0,0 +1,58 @@
+/*
+ * Binary websocket frames
+ * A compact alternative to the JSON datapoint message, for clients that ask for it.
+ * Frames are a fixed layout, little-endian, written byte by byte (so they don't depend on struct packing
+ * or the CPU's byte order), into a buffer the caller owns. No heap.
+ *
+ * Every frame starts with
+ *   0  uint8   FRAME_VERSION
+ *   1  uint8   frame type
+ *
+ * Datapoints (FRAME_DATAPOINTS), several samples in one frame, DATAPOINTS_HEADER_SIZE + count*DATAPOINT_RECORD_SIZE bytes:
+ *   2  uint16  count
+ *   4  uint32  sequence number of the first sample (see roastHistory.h), the rest follow on from it
+ *   8  count records, oldest first, of:
+ *        0  uint32  timestamp, time since the controller started [ms]
+ *        4  float32 setpoint [oC]
+ *        8  float32 output [%]
+ *       12  float32 temperature [oC] (NaN if the thermocouple has a fault)
+ *
+ * Decimated datapoints (FRAME_DECIMATED), a downsampled selection of the history (see decimator.h):
+ *   the same as FRAME_DATAPOINTS, but the samples aren't consecutive, so the uint32 at 4 is instead the sequence
+ *   number to carry on from after this frame (one after the last sample it covers)
+ *
+ * Type 1 was a frame of one datapoint, which nothing sends since they are batched. Don't reuse it.
+ * Change FRAME_VERSION whenever a layout changes, the browser ignores versions it doesn't know.
+ */
+#ifndef DATAFRAME_H
+#define DATAFRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FRAME_VERSION 2
+#define FRAME_DATAPOINTS 2
+#define FRAME_DECIMATED 3
+#define DATAPOINTS_HEADER_SIZE 8
+#define DATAPOINT_RECORD_SIZE 16
+
+struct DatapointFrame {
+  uint32_t timestamp;  // [ms]
+  float setpoint;
+  float output;
+  float temperature;
+};
+
+// Encode count samples, starting at sequence number firstSeq, into one frame
+// Returns the number of bytes written (0 if len is too small)
+size_t encodeDatapointsFrame(uint8_t *buf, size_t len, uint32_t firstSeq, const DatapointFrame *points, size_t count);
+
+// The same for a FRAME_DECIMATED frame, covering everything up to nextSeq
+size_t encodeDecimatedFrame(uint8_t *buf, size_t len, uint32_t nextSeq, const DatapointFrame *points, size_t count);
+
+// Decode a multi-sample frame (FRAME_DATAPOINTS or FRAME_DECIMATED) into points (up to max of them),
+// returns how many there were, 0 if it isn't one, or is cut short
+// seq is the first sequence number (FRAME_DATAPOINTS) or the one to carry on from (FRAME_DECIMATED)
+size_t decodeDatapointsFrame(const uint8_t *buf, size_t len, uint32_t *seq, DatapointFrame *points, size_t max);
+
+#endif  // DATAFRAME_H
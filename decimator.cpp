@@ -0,0 +1,102 @@
+#include "decimator.h"
+#include <math.h>
+
+
+uint32_t lowerBound(const SampleSeries &series, uint32_t start, uint32_t end, double value){
+  while(start < end){
+    uint32_t mid = start + (end - start)/2;
+    if(series.x(mid) < value){
+      start = mid + 1;
+    }else{
+      end = mid;
+    }
+  }
+  return(start);
+}
+
+
+Lttb::Lttb(){
+  begin(0, 0, 0);
+}
+
+
+/*
+ * Start on the samples [start, end), picking threshold of them (at least 3)
+ */
+void Lttb::begin(uint32_t start, uint32_t end, uint32_t threshold){
+  _start = start;
+  _end = end > start ? end : start;
+  _threshold = threshold < 3 ? 3 : threshold;
+  _emitted = 0;
+  _a = start;
+}
+
+
+bool Lttb::done() const{
+  uint32_t n = _end - _start;
+  return(_emitted >= (n < _threshold ? n : _threshold));
+}
+
+
+/*
+ * Work out the next point, returns false when there are no more
+ */
+bool Lttb::next(const SampleSeries &series, uint32_t *index){
+  if(done()){
+    return(false);
+  }
+  uint32_t n = _end - _start;
+
+  // few enough to keep them all, and the ends are always kept
+  if(n <= _threshold || _emitted == 0){
+    *index = _start + _emitted++;
+    _a = *index;
+    return(true);
+  }
+  if(_emitted == _threshold - 1){
+    *index = _end - 1;
+    _emitted++;
+    return(true);
+  }
+
+  // bucket b of the threshold-2 buckets the points between the ends are split into
+  // integer maths, so the buckets always tile the range exactly
+  uint32_t buckets = _threshold - 2;
+  uint32_t inner = n - 2;
+  uint32_t b = _emitted - 1;
+  uint32_t bucketStart = _start + 1 + (uint32_t)((uint64_t)b*inner/buckets);
+  uint32_t bucketEnd = _start + 1 + (uint32_t)((uint64_t)(b + 1)*inner/buckets);
+
+  // average of the next bucket (just the last point, for the last bucket)
+  uint32_t nextStart = bucketEnd;
+  uint32_t nextEnd = b + 1 < buckets ? _start + 1 + (uint32_t)((uint64_t)(b + 2)*inner/buckets) : _end;
+  if(b + 1 >= buckets){
+    nextStart = _end - 1;
+  }
+  double avgX = 0, avgY = 0;
+  for(uint32_t i=nextStart; i<nextEnd; i++){
+    avgX += series.x(i);
+    avgY += series.y(i);
+  }
+  avgX /= (nextEnd - nextStart);
+  avgY /= (nextEnd - nextStart);
+
+  // the point in this bucket making the biggest triangle with the last point and that average
+  double ax = series.x(_a);
+  double ay = series.y(_a);
+  double maxArea = -1;
+  uint32_t picked = bucketStart;
+  for(uint32_t i=bucketStart; i<bucketEnd; i++){
+    double y = series.y(i);
+    // a NaN (thermocouple fault) never wins, if it is all NaNs the first one is kept
+    double area = fabs((ax - avgX)*(y - ay) - (ax - series.x(i))*(avgY - ay));
+    if(area > maxArea){
+      maxArea = area;
+      picked = i;
+    }
+  }
+  *index = picked;
+  _a = picked;
+  _emitted++;
+  return(true);
+}
@@ -0,0 +1,46 @@
+/*
+ * Largest-Triangle-Three-Buckets downsampling
+ * Picks threshold points out of a series of samples so that a chart of them looks like a chart of all of them
+ * (https://skemman.is/handle/1946/15343). The first and last points are always kept, the rest are split into
+ * threshold-2 equal buckets and from each bucket the point making the largest triangle with the point picked
+ * from the previous bucket and the average of the next bucket is kept.
+ *
+ * It works on any SampleSeries (x and y of a sample by index), over a range of indices.
+ * The points are produced one at a time by next(), which only needs the state in the Lttb object (a few words),
+ * so it can be spread over as many calls (eg. main loops) as you like. Every sample is read at most twice,
+ * so it is O(n) however the work is split up.
+ * If the range has no more than threshold samples they are all returned.
+ */
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+class SampleSeries {
+ public:
+  virtual ~SampleSeries() {}
+  virtual double x(uint32_t i) const = 0;
+  virtual double y(uint32_t i) const = 0;
+};
+
+// First index in [start, end) with x >= value (end if none). The series must be sorted by x.
+uint32_t lowerBound(const SampleSeries &series, uint32_t start, uint32_t end, double value);
+
+
+class Lttb {
+ public:
+  Lttb();
+
+  void begin(uint32_t start, uint32_t end, uint32_t threshold);
+  bool next(const SampleSeries &series, uint32_t *index);
+  bool done() const;
+
+ private:
+  uint32_t _start, _end;   // the range of indices [start, end)
+  uint32_t _threshold;
+  uint32_t _emitted;       // points returned so far
+  uint32_t _a;             // the last point returned
+};
+
+#endif  // DECIMATOR_H
@@ -0,0 +1,113 @@
+#include "estimator.h"
+#include <math.h>
+
+#define BEAN 0
+#define PROBE 1
+#define DIST 2
+
+
+TemperatureEstimator::TemperatureEstimator(){
+  setModel(ESTIMATOR_GAIN, ESTIMATOR_TAU, ESTIMATOR_PROBE_TAU);
+  setNoise(0.25, 0.05, 2.0);
+  reset(ESTIMATOR_AMBIENT);
+  _initialised = false;
+}
+
+
+void TemperatureEstimator::setModel(double gain, double tau, double probeTau){
+  _gain = gain;
+  _tau = tau > 0 ? tau : 1;
+  _probeTau = probeTau > 0 ? probeTau : 0;
+}
+
+void TemperatureEstimator::setNoise(double measurementVar, double beanVar, double disturbanceVar){
+  _r = measurementVar;
+  _qBean = beanVar;
+  _qProbe = beanVar/10;
+  _qDist = disturbanceVar;
+}
+
+
+/*
+ * Start from everything at the given (measured) temperature, with no idea what the disturbance is
+ */
+void TemperatureEstimator::reset(double temperature){
+  _x[BEAN] = temperature;
+  _x[PROBE] = temperature;
+  _x[DIST] = 0;
+  for(int i=0; i<3; i++){
+    for(int j=0; j<3; j++){
+      _P[i][j] = 0;
+    }
+  }
+  _P[BEAN][BEAN] = 1;
+  _P[PROBE][PROBE] = _r;
+  _P[DIST][DIST] = 100;
+  _initialised = true;
+}
+
+
+/*
+ * Predict forward dt [s] with the heater at power [0, 1], then correct with the measurement
+ * Returns the new bean temperature estimate
+ */
+double TemperatureEstimator::update(double measurement, double power, double dt){
+  if(!_initialised){
+    reset(measurement);
+    return(_x[BEAN]);
+  }
+  if(dt > 0){
+    double ab = exp(-dt/_tau);
+    double ap = _probeTau > 0 ? exp(-dt/_probeTau) : 0;
+
+    // predict
+    double F[3][3] = {{ab, 0, 1 - ab},
+                      {1 - ap, ap, 0},
+                      {0, 0, 1}};
+    double bean = ab*_x[BEAN] + (1 - ab)*(_gain*power + ESTIMATOR_AMBIENT + _x[DIST]);
+    _x[PROBE] = ap*_x[PROBE] + (1 - ap)*_x[BEAN];
+    _x[BEAN] = bean;
+
+    // P = F*P*F' + Q*dt
+    double FP[3][3];
+    for(int i=0; i<3; i++){
+      for(int j=0; j<3; j++){
+        FP[i][j] = F[i][0]*_P[0][j] + F[i][1]*_P[1][j] + F[i][2]*_P[2][j];
+      }
+    }
+    for(int i=0; i<3; i++){
+      for(int j=0; j<3; j++){
+        _P[i][j] = FP[i][0]*F[j][0] + FP[i][1]*F[j][1] + FP[i][2]*F[j][2];
+      }
+    }
+    _P[BEAN][BEAN] += _qBean*dt;
+    _P[PROBE][PROBE] += _qProbe*dt;
+    _P[DIST][DIST] += _qDist*dt;
+  }
+
+  // correct. Only the probe is measured, so the gain is just the probe column of P
+  double s = _P[PROBE][PROBE] + _r;
+  double K[3] = {_P[BEAN][PROBE]/s, _P[PROBE][PROBE]/s, _P[DIST][PROBE]/s};
+  double innovation = measurement - _x[PROBE];
+  double Prow[3] = {_P[PROBE][0], _P[PROBE][1], _P[PROBE][2]};
+  for(int i=0; i<3; i++){
+    _x[i] += K[i]*innovation;
+    for(int j=0; j<3; j++){
+      _P[i][j] -= K[i]*Prow[j];
+    }
+  }
+  return(_x[BEAN]);
+}
+
+
+double TemperatureEstimator::getTemperature(){
+  return(_x[BEAN]);
+}
+
+double TemperatureEstimator::getProbeTemperature(){
+  return(_x[PROBE]);
+}
+
+double TemperatureEstimator::getDisturbance(){
+  return(_x[DIST]);
+}
@@ -0,0 +1,49 @@
+/*
+ * Bean temperature estimator
+ * The thermocouple lags the beans by a few seconds, which limits how hard the PID can push.
+ * This is a Kalman filter on a model of the roaster, which uses the known heater output to predict
+ * the bean temperature now rather than waiting for the probe to catch up.
+ *
+ * States: bean temperature Tb, probe temperature Tp, and a heat input disturbance d [oC] that soaks up
+ * whatever the model gets wrong (ambient, gain, fan) so there is no steady state offset.
+ *   dTb/dt = (gain*u + d - (Tb - ambient)) / tau
+ *   dTp/dt = (Tb - Tp) / probeTau
+ *   d is a random walk
+ * u is the heater power [0, 1] over the last interval, the measurement is Tp.
+ * The first order parts are discretised exactly, so any sample interval is stable.
+ *
+ * update() is called once per controller sample (with the time since the last one), so the double maths
+ * is no real load even without an FPU.
+ */
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+
+#define ESTIMATOR_GAIN 300        // temperature rise at full power [oC]
+#define ESTIMATOR_TAU 90          // roaster time constant [s]
+#define ESTIMATOR_PROBE_TAU 5     // thermocouple time constant [s]
+#define ESTIMATOR_AMBIENT 20      // [oC]
+
+enum EstimatorMode {ESTIMATOR_OFF, ESTIMATOR_KALMAN};
+
+class TemperatureEstimator {
+ public:
+  TemperatureEstimator();
+
+  void setModel(double gain, double tau, double probeTau);
+  void setNoise(double measurementVar, double beanVar, double disturbanceVar);
+  void reset(double temperature);
+  double update(double measurement, double power, double dt);
+  double getTemperature();
+  double getProbeTemperature();
+  double getDisturbance();
+
+ private:
+  double _gain, _tau, _probeTau;
+  double _r;              // measurement noise variance [oC^2]
+  double _qBean, _qProbe, _qDist;  // process noise [variance/s]
+  double _x[3];           // Tb, Tp, d
+  double _P[3][3];
+  bool _initialised;
+};
+
+#endif  // ESTIMATOR_H
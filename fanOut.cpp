@@ -0,0 +1,143 @@
+#include "fanOut.h"
+
+
+FanOut::FanOut(FanOutTransport *transport, uint8_t maxClients) : _transport(transport) {
+  _maxClients = maxClients > FANOUT_MAX_CLIENTS ? FANOUT_MAX_CLIENTS : maxClients;
+  _budget = FANOUT_BUDGET;
+  _stuckTimeout = FANOUT_STUCK_TIMEOUT;
+  _overBudget = 0;
+  _messages = 0;
+  _bytes = 0;
+  _dropped = 0;
+  _coalesced = 0;
+  _failed = 0;
+  _disconnects = 0;
+  _peakQueued = 0;
+}
+
+
+/*
+ * Send the message to each of the clients which can take it now
+ * Returns the clients it was sent to, the rest were skipped (or the send failed).
+ */
+uint32_t FanOut::send(uint32_t clients, uint8_t *frame, size_t length, bool binary, FanOutPolicy policy){
+  uint32_t sent = 0;
+  for(uint8_t num=0; num<_maxClients; num++){
+    uint32_t bit = 1UL << num;
+    if(!(clients & bit)){
+      continue;
+    }
+    if(!ready(num, length)){
+      if(policy == FANOUT_COALESCE){
+        _coalesced++;
+      }else{
+        _dropped++;
+      }
+      continue;
+    }
+    if(_transport->send(num, frame, length, binary)){
+      sent |= bit;
+      _messages++;
+      _bytes += length;
+    }else{
+      _failed++;
+    }
+  }
+  return(sent);
+}
+
+
+/*
+ * Can client num take a message of length bytes now
+ * Also keeps track of how long it has been over budget.
+ */
+bool FanOut::ready(uint8_t num, size_t length){
+  if(num >= _maxClients){
+    return(false);
+  }
+  size_t queued = _transport->queued(num);
+  if(queued > _peakQueued){
+    _peakQueued = queued;
+  }
+  uint32_t bit = 1UL << num;
+  if(queued <= _budget && _transport->writable(num) >= length){
+    _overBudget &= ~bit;
+    return(true);
+  }
+  if(!(_overBudget & bit)){
+    _overBudget |= bit;
+    _overBudgetSince[num] = millis();
+  }
+  return(false);
+}
+
+
+/*
+ * Disconnect any client which has been over budget for too long
+ */
+void FanOut::process(){
+  if(!_overBudget){
+    return;
+  }
+  for(uint8_t num=0; num<_maxClients; num++){
+    if(!(_overBudget & (1UL << num)) || ready(num, 1)){
+      continue;
+    }
+    if((uint32_t)(millis() - _overBudgetSince[num]) >= _stuckTimeout){
+      _overBudget &= ~(1UL << num);
+      _disconnects++;
+      _transport->disconnect(num);
+    }
+  }
+}
+
+
+/*
+ * Forget about client num (when it connects or disconnects)
+ */
+void FanOut::reset(uint8_t num){
+  if(num < _maxClients){
+    _overBudget &= ~(1UL << num);
+  }
+}
+
+
+void FanOut::setBudget(size_t budget){
+  _budget = budget;
+}
+
+size_t FanOut::getBudget(){
+  return(_budget);
+}
+
+void FanOut::setStuckTimeout(unsigned long timeout){
+  _stuckTimeout = timeout;
+}
+
+unsigned long FanOut::getMessages(){
+  return(_messages);
+}
+
+unsigned long FanOut::getBytes(){
+  return(_bytes);
+}
+
+unsigned long FanOut::getDropped(){
+  return(_dropped);
+}
+
+unsigned long FanOut::getCoalesced(){
+  return(_coalesced);
+}
+
+unsigned long FanOut::getFailed(){
+  return(_failed);
+}
+
+unsigned long FanOut::getDisconnects(){
+  return(_disconnects);
+}
+
+size_t FanOut::getPeakQueued(){
+  return(_peakQueued);
+}
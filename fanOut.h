@@ -0,0 +1,74 @@
+/*
+ * Websocket fan-out with backpressure
+ * Sends one already built message to a set of clients (one bit per client number), skipping any client whose
+ * connection is backed up rather than queueing more for it. A slow phone then costs a few counters instead of
+ * TCP buffers growing until the heap runs out.
+ *
+ * A client is over budget when its connection has more than the budget queued and not yet acknowledged, or
+ * hasn't room for the whole message (the send would block the main loop). Messages it is skipped for are
+ * counted as dropped or coalesced, as the caller says: coalesced means the caller will send what it missed
+ * later in one go (the datapoints from the history, the status as one set of changes), dropped means gone.
+ * A client which stays over budget for the stuck timeout is disconnected.
+ *
+ * The connections themselves are behind FanOutTransport. process() needs to be called every main loop.
+ */
+#ifndef FANOUT_H
+#define FANOUT_H
+
+#include <Arduino.h>
+
+#define FANOUT_MAX_CLIENTS 32
+#define FANOUT_BUDGET 2048          // [bytes] queued on a connection before it is skipped
+#define FANOUT_STUCK_TIMEOUT 15000  // [ms] over budget for this long and it is disconnected
+
+enum FanOutPolicy {FANOUT_DROP, FANOUT_COALESCE};
+
+class FanOutTransport {
+ public:
+  virtual ~FanOutTransport() {}
+  virtual size_t queued(uint8_t num) = 0;    // bytes sent but not acknowledged yet
+  virtual size_t writable(uint8_t num) = 0;  // bytes which can be sent without blocking
+  // frame has the library's header room in front of the message (see webServer.cpp)
+  virtual bool send(uint8_t num, uint8_t *frame, size_t length, bool binary) = 0;
+  virtual void disconnect(uint8_t num) = 0;
+};
+
+class FanOut {
+ public:
+  FanOut(FanOutTransport *transport, uint8_t maxClients);
+
+  uint32_t send(uint32_t clients, uint8_t *frame, size_t length, bool binary, FanOutPolicy policy);
+  bool ready(uint8_t num, size_t length);
+  void process();
+  void reset(uint8_t num);
+
+  void setBudget(size_t budget);
+  size_t getBudget();
+  void setStuckTimeout(unsigned long timeout);
+
+  unsigned long getMessages();
+  unsigned long getBytes();
+  unsigned long getDropped();
+  unsigned long getCoalesced();
+  unsigned long getFailed();
+  unsigned long getDisconnects();
+  size_t getPeakQueued();
+
+ private:
+  FanOutTransport *_transport;
+  uint8_t _maxClients;
+  size_t _budget;
+  unsigned long _stuckTimeout;
+  uint32_t _overBudget;                                // clients over budget the last time they were checked
+  uint32_t _overBudgetSince[FANOUT_MAX_CLIENTS];       // [ms] when they went over
+
+  unsigned long _messages;     // sent, one per client
+  unsigned long _bytes;
+  unsigned long _dropped;      // skipped, one per client
+  unsigned long _coalesced;
+  unsigned long _failed;       // the send itself failed
+  unsigned long _disconnects;  // stuck clients disconnected
+  size_t _peakQueued;
+};
+
+#endif  // FANOUT_H
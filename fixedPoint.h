@@ -0,0 +1,56 @@
+/*
+ * Signed fixed point number, FRAC_BITS fractional bits in a 32bit integer
+ * For doing the control maths on the ESP8266, which has no FPU (every double operation is a software routine).
+ * Multiply and divide go through a 64bit intermediate so they don't lose the fractional bits.
+ * Arithmetic saturates at the ends of the range instead of wrapping around, so a large gain times a large
+ * error is the biggest number there is rather than a negative one (the PID clamps the output anyway).
+ * Converting a double out of range doesn't saturate: keep those inside the range.
+ *
+ * Q16_16: +/-32768 with a resolution of 1.5e-5. Enough for temperatures, PID gains and terms.
+ * Q8_24:  +/-128 with a resolution of 6e-8. Not suitable for temperatures in oC (a roast goes well past 128).
+ */
+#ifndef FIXEDPOINT_H
+#define FIXEDPOINT_H
+
+#include <stdint.h>
+
+template <int FRAC_BITS>
+class Fixed {
+ public:
+  Fixed() : _raw(0) {}
+  explicit Fixed(double value) : _raw((int32_t)(value*(1L << FRAC_BITS) + (value < 0 ? -0.5 : 0.5))) {}
+  explicit Fixed(int value) : _raw((int32_t)value << FRAC_BITS) {}
+  explicit Fixed(long value) : _raw((int32_t)value << FRAC_BITS) {}
+  explicit Fixed(unsigned long value) : _raw((int32_t)value << FRAC_BITS) {}
+
+  static Fixed fromRaw(int32_t raw) { Fixed f; f._raw = raw; return f; }
+  int32_t raw() const { return _raw; }
+  explicit operator double() const { return (double)_raw/(1L << FRAC_BITS); }
+
+  Fixed operator-() const { return fromRaw(saturate(-(int64_t)_raw)); }
+  Fixed operator+(Fixed rhs) const { return fromRaw(saturate((int64_t)_raw + rhs._raw)); }
+  Fixed operator-(Fixed rhs) const { return fromRaw(saturate((int64_t)_raw - rhs._raw)); }
+  Fixed operator*(Fixed rhs) const { return fromRaw(saturate(((int64_t)_raw*rhs._raw) >> FRAC_BITS)); }
+  Fixed operator/(Fixed rhs) const { return fromRaw(saturate(((int64_t)_raw << FRAC_BITS)/rhs._raw)); }
+  Fixed &operator+=(Fixed rhs) { _raw = saturate((int64_t)_raw + rhs._raw); return *this; }
+  Fixed &operator-=(Fixed rhs) { _raw = saturate((int64_t)_raw - rhs._raw); return *this; }
+
+  bool operator<(Fixed rhs) const { return _raw < rhs._raw; }
+  bool operator>(Fixed rhs) const { return _raw > rhs._raw; }
+  bool operator<=(Fixed rhs) const { return _raw <= rhs._raw; }
+  bool operator>=(Fixed rhs) const { return _raw >= rhs._raw; }
+  bool operator==(Fixed rhs) const { return _raw == rhs._raw; }
+  bool operator!=(Fixed rhs) const { return _raw != rhs._raw; }
+
+ private:
+  static int32_t saturate(int64_t raw) {
+    return raw > INT32_MAX ? INT32_MAX : (raw < INT32_MIN ? INT32_MIN : (int32_t)raw);
+  }
+
+  int32_t _raw;
+};
+
+typedef Fixed<16> Q16_16;
+typedef Fixed<24> Q8_24;
+
+#endif  // FIXEDPOINT_H
@@ -0,0 +1,31 @@
+/*
+ * Host stand-in for the Adafruit MAX31855 thermocouple library
+ * Reads come from whatever ThermocoupleSource is plugged into the HAL for the calling thread.
+ * Like the real library, readCelsius() is NAN when the source reports a fault.
+ */
+#ifndef ADAFRUIT_MAX31855_H
+#define ADAFRUIT_MAX31855_H
+
+#include <Arduino.h>
+
+class Adafruit_MAX31855 {
+ public:
+  Adafruit_MAX31855(int8_t cs) : _cs(cs) {}
+
+  void begin() {}
+  double readInternal() { return 25.0; }
+  double readCelsius() {
+    ThermocoupleSource &source = hal::thermocouple();
+    if(source.readError()){
+      return NAN;
+    }
+    return source.readCelsius();
+  }
+  double readFarenheit() { return readCelsius()*9.0/5.0 + 32; }
+  uint8_t readError() { return hal::thermocouple().readError(); }
+
+ private:
+  int8_t _cs;
+};
+
+#endif  // ADAFRUIT_MAX31855_H
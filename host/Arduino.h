@@ -0,0 +1,108 @@
+/*
+ * Host stand-in for the Arduino core
+ * Provides the types, constants and functions the controller code uses,
+ * forwarding time and GPIO to the pluggable interfaces in hal.h.
+ * Pin numbers are the NodeMCU (ESP8266) ones so the controller code compiles unchanged.
+ */
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <math.h>
+#include <memory>
+#include "WString.h"
+#include "hal.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+#define SS 15
+
+#define ICACHE_RAM_ATTR
+
+inline unsigned long millis() { return hal::clock().millis(); }
+inline unsigned long micros() { return hal::clock().micros(); }
+inline void pinMode(uint8_t pin, uint8_t mode) { hal::gpio().pinMode(pin, mode); }
+inline void digitalWrite(uint8_t pin, uint8_t value) { hal::gpio().digitalWrite(pin, value); }
+inline int digitalRead(uint8_t pin) { return hal::gpio().digitalRead(pin); }
+inline void yield() {}
+
+
+// timer1, runs off the thread's clock (see HostTimer in hal.h)
+#define TIM_DIV1 0
+#define TIM_DIV16 1
+#define TIM_DIV256 3
+#define TIM_EDGE 0
+#define TIM_LEVEL 1
+#define TIM_SINGLE 0
+#define TIM_LOOP 1
+
+void timer1_attachInterrupt(void (*userFunc)(void));
+void timer1_detachInterrupt();
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload);
+void timer1_disable();
+void timer1_write(uint32_t ticks);
+
+
+/*
+ * Serial port. Output is dropped unless hal::setSerialEcho(true), then it goes to stdout.
+ */
+class HardwareSerial {
+ public:
+  void begin(unsigned long baud) { (void)baud; }
+
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(const char *s) { return write(s); }
+  size_t print(char c);
+  size_t print(int n) { return print((long)n); }
+  size_t print(unsigned int n) { return print((unsigned long)n); }
+  size_t print(long n);
+  size_t print(unsigned long n);
+  size_t print(double n, int digits = 2);
+
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(const T &value) { size_t n = print(value); return n + println(); }
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+  // room in the transmit FIFO, there is always room on the host
+  int availableForWrite() { return 256; }
+
+ private:
+  size_t write(const char *s);
+};
+
+extern HardwareSerial Serial;
+
+
+/*
+ * The ESP object. The cycle counter counts at getCpuFreqMHz() off the host's real (steady) clock, so stage timings
+ * measure the host, not the virtual clock. There is no heap to report.
+ */
+class EspClass {
+ public:
+  uint32_t getCycleCount();
+  uint8_t getCpuFreqMHz() { return 80; }
+  uint32_t getFreeHeap() { return 0; }
+  uint32_t getMaxFreeBlockSize() { return 0; }
+};
+
+extern EspClass ESP;
+
+#endif  // ARDUINO_H
@@ -0,0 +1,10 @@
+/*
+ * Host stand-in for ESP8266WebServer
+ * The host build doesn't run the web server, the type only needs to exist for webServer.h
+ */
+#ifndef ESP8266WEBSERVER_H
+#define ESP8266WEBSERVER_H
+
+class ESP8266WebServer;
+
+#endif  // ESP8266WEBSERVER_H
@@ -0,0 +1,7 @@
+/*
+ * Host stand-in for the ESP8266 ESP8266WiFi header (no networking on the host)
+ */
+#ifndef ESP8266WIFI_H
+#define ESP8266WIFI_H
+
+#endif  // ESP8266WIFI_H
@@ -0,0 +1,7 @@
+/*
+ * Host stand-in for the Arduino SPI library (the thermocouple shim doesn't use SPI)
+ */
+#ifndef SPI_H
+#define SPI_H
+
+#endif  // SPI_H
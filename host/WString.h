@@ -0,0 +1,47 @@
+/*
+ * Host stand-in for the Arduino String class
+ * Only the parts the controller code uses. Backed by std::string.
+ */
+#ifndef WSTRING_H
+#define WSTRING_H
+
+#include <string>
+
+
+class String {
+ public:
+  String() {}
+  String(const char *str) : _str(str ? str : "") {}
+  String(const std::string &str) : _str(str) {}
+  explicit String(char c) : _str(1, c) {}
+  explicit String(int value);
+  explicit String(unsigned int value);
+  explicit String(long value);
+  explicit String(unsigned long value);
+  explicit String(unsigned char value);
+  explicit String(double value, unsigned char decimalPlaces = 2);
+
+  const char *c_str() const { return _str.c_str(); }
+  unsigned int length() const { return _str.length(); }
+  void reserve(unsigned int size) { _str.reserve(size); }
+  bool startsWith(const String &prefix) const;
+  bool endsWith(const String &suffix) const;
+
+  String &operator+=(const String &rhs) { _str += rhs._str; return *this; }
+  String &operator+=(const char *rhs) { _str += rhs; return *this; }
+  String &operator+=(char rhs) { _str += rhs; return *this; }
+
+  bool operator==(const String &rhs) const { return _str == rhs._str; }
+  bool operator==(const char *rhs) const { return _str == rhs; }
+  bool operator!=(const String &rhs) const { return _str != rhs._str; }
+  bool operator!=(const char *rhs) const { return _str != rhs; }
+
+  friend String operator+(const String &lhs, const String &rhs) { return String(lhs._str + rhs._str); }
+  friend String operator+(const String &lhs, const char *rhs) { return String(lhs._str + rhs); }
+  friend String operator+(const char *lhs, const String &rhs) { return String(lhs + rhs._str); }
+
+ private:
+  std::string _str;
+};
+
+#endif  // WSTRING_H
@@ -0,0 +1,10 @@
+/*
+ * Host stand-in for WebSocketsServer
+ * The host build doesn't run the websocket server, the type only needs to exist for webServer.h
+ */
+#ifndef WEBSOCKETSSERVER_H
+#define WEBSOCKETSSERVER_H
+
+class WebSocketsServer;
+
+#endif  // WEBSOCKETSSERVER_H
@@ -0,0 +1,7 @@
+/*
+ * Host stand-in for the ESP8266 WiFiClient header (no networking on the host)
+ */
+#ifndef WIFICLIENT_H
+#define WIFICLIENT_H
+
+#endif  // WIFICLIENT_H
@@ -0,0 +1,132 @@
+/*
+ * Implementation of the host Arduino core stand-ins (String, Serial, timer1)
+ */
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+// timer1 clock divider, the timer input is the 80MHz CPU clock divided by this
+namespace {
+  thread_local uint32_t timer1Divider = 16;
+}
+
+
+String::String(int value) : _str(std::to_string(value)) {}
+String::String(unsigned int value) : _str(std::to_string(value)) {}
+String::String(long value) : _str(std::to_string(value)) {}
+String::String(unsigned long value) : _str(std::to_string(value)) {}
+String::String(unsigned char value) : _str(std::to_string(value)) {}
+
+String::String(double value, unsigned char decimalPlaces){
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+  _str = buf;
+}
+
+bool String::startsWith(const String &prefix) const{
+  return(_str.compare(0, prefix._str.length(), prefix._str) == 0);
+}
+
+bool String::endsWith(const String &suffix) const{
+  if(suffix._str.length() > _str.length()){
+    return(false);
+  }
+  return(_str.compare(_str.length() - suffix._str.length(), suffix._str.length(), suffix._str) == 0);
+}
+
+
+size_t HardwareSerial::write(const char *s){
+  size_t len = strlen(s);
+  if(hal::serialEcho()){
+    fwrite(s, 1, len, stdout);
+  }
+  return(len);
+}
+
+size_t HardwareSerial::print(char c){
+  if(!hal::serialEcho()){
+    return(0);
+  }
+  char buf[2] = {c, 0};
+  return(write(buf));
+}
+
+size_t HardwareSerial::print(long n){
+  if(!hal::serialEcho()){
+    return(0);
+  }
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%ld", n);
+  return(write(buf));
+}
+
+size_t HardwareSerial::print(unsigned long n){
+  if(!hal::serialEcho()){
+    return(0);
+  }
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%lu", n);
+  return(write(buf));
+}
+
+size_t HardwareSerial::print(double n, int digits){
+  if(!hal::serialEcho()){
+    return(0);
+  }
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return(write(buf));
+}
+
+size_t HardwareSerial::printf(const char *format, ...){
+  if(!hal::serialEcho()){
+    return(0);
+  }
+  va_list args;
+  va_start(args, format);
+  int n = vprintf(format, args);
+  va_end(args);
+  return(n < 0 ? 0 : n);
+}
+
+
+void timer1_attachInterrupt(void (*userFunc)(void)){
+  hal::timer1().callback = userFunc;
+}
+
+void timer1_detachInterrupt(){
+  hal::timer1().callback = NULL;
+}
+
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload){
+  HostTimer &timer = hal::timer1();
+  timer1Divider = divider == TIM_DIV256 ? 256 : (divider == TIM_DIV16 ? 16 : 1);
+  timer.reload = reload == TIM_LOOP;
+  timer.enabled = true;
+}
+
+void timer1_disable(){
+  hal::timer1().enabled = false;
+}
+
+/*
+ * Start counting down from ticks, the interrupt fires when it gets to 0
+ */
+void timer1_write(uint32_t ticks){
+  HostTimer &timer = hal::timer1();
+  timer.periodUs = ((uint64_t)ticks*timer1Divider + 40)/80;
+  timer.nextFire = hal::clock().nowMicros() + timer.periodUs;
+}
+
+
+/*
+ * The host's real time in CPU cycles, wrapping at 2^32 like the ESP's does (every 53 s at 80MHz)
+ */
+uint32_t EspClass::getCycleCount(){
+  uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  return((uint32_t)(ns*getCpuFreqMHz()/1000));
+}
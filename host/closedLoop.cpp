@@ -0,0 +1,66 @@
+#include "closedLoop.h"
+#include "hal.h"
+#include "../controller.h"
+
+
+RoastConfig::RoastConfig(){
+  setpoint = 200;
+  duration = 900;
+  sampleInterval = SAMPLE_INTERVAL;
+  loopPeriodUs = 10000;
+  plantStep = 0.01;
+  band = 2.0;
+}
+
+
+StepResult simulateRoast(const RoastConfig &config, double p, double i, double d){
+  VirtualClock clock;
+  PinBank pins;
+  hal::setClock(&clock);
+  hal::setGpio(&pins);
+
+  ThermalPlant plant(config.plant, config.plantStep);
+  StepMetrics metrics(config.band, config.duration - 60);
+  PID pid(p, i, d);
+  TriacOutput triac(TRIAC_PIN);
+  Fan fan(FAN_PIN);
+  pid.setOutputLimits(0, 100);
+  pid.setSetpoint(config.setpoint);
+  fan.on();
+
+  unsigned long sampleIntervalUs = config.sampleInterval*1000;
+  uint32_t prevMicros = clock.micros();
+  uint64_t plantStepUs = (uint64_t)(config.plantStep*1e6);
+  uint64_t gateOnUs = 0;
+  uint64_t stepUs = 0;
+  while(plant.time() < config.duration){
+    clock.advanceMicros(config.loopPeriodUs);
+
+    uint32_t now = clock.micros();
+    uint32_t elapsed = now - prevMicros;
+    if(elapsed >= sampleIntervalUs){
+      prevMicros = elapsed < 2*sampleIntervalUs ? prevMicros + sampleIntervalUs : now;
+      double temperature = plant.readCelsius();
+      double output = pid.compute(temperature);
+      triac.setDutyCycle(output);
+      triac.enable();
+      metrics.add(plant.time(), config.setpoint, temperature);
+    }
+    triac.process();
+
+    if(pins.digitalRead(TRIAC_PIN)){
+      gateOnUs += config.loopPeriodUs;
+    }
+    stepUs += config.loopPeriodUs;
+    // the plant steps on the first loop at or after each plant step (loopPeriodUs <= plantStep)
+    if(stepUs >= plantStepUs){
+      plant.step((double)gateOnUs/stepUs, pins.digitalRead(FAN_PIN));
+      stepUs = 0;
+      gateOnUs = 0;
+    }
+  }
+
+  hal::setClock(NULL);
+  hal::setGpio(NULL);
+  return(metrics.result());
+}
@@ -0,0 +1,30 @@
+/*
+ * Self-contained closed loop roast simulation
+ * Builds its own PID, TriacOutput, Fan, thermal plant, virtual clock and pins, and runs the same sequence as
+ * Controller::process() in the HOLD state (sample every sampleInterval, compute, update the triac duty cycle,
+ * run the triac every loop). It doesn't touch the controller singleton, and the HAL is per-thread,
+ * so any number of these can run in parallel.
+ * The triac is polled (TRIAC_POLLED) rather than timer driven, as there is no loop load to disturb it here
+ * and it saves running the timer interrupt every tick.
+ */
+#ifndef CLOSEDLOOP_H
+#define CLOSEDLOOP_H
+
+#include "thermalPlant.h"
+#include "stepMetrics.h"
+
+struct RoastConfig {
+  double setpoint;                // [oC]
+  double duration;                // [s]
+  unsigned long sampleInterval;   // controller sample interval [ms]
+  unsigned long loopPeriodUs;     // time between loop() iterations [us]
+  double plantStep;               // plant integration step [s]
+  double band;                    // settling band [oC]
+  PlantParams plant;
+
+  RoastConfig();
+};
+
+StepResult simulateRoast(const RoastConfig &config, double p, double i, double d);
+
+#endif  // CLOSEDLOOP_H
@@ -0,0 +1,132 @@
+/*
+ * Two thread stress test of the controller event queue (controllerEvents.h, spscRing.h)
+ * A producer thread fills events in place (claim()/publish()) as fast as it can, a consumer thread reads them in
+ * place (front()/pop()) and checks every one: in order, nothing repeated, the contents exactly what was written.
+ * Every event carries its sequence number and fields worked out from it, so a torn or stale slot shows up.
+ *  - by default the producer waits when the queue is full, so every event has to arrive
+ *  - with -d it drops them instead (as the controller does), and the ones which arrive have to be in order and
+ *    add up with the drops to the number sent
+ * The consumer can be slowed down with -s to keep the queue full.
+ * Exits 1 if anything was wrong.
+ *
+ * usage: eventQueueStress [-n events] [-d] [-s consumer_spin]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include "../controllerEvents.h"
+
+static ControllerEventQueue queue;
+
+
+static void fill(ControllerEvent *event, uint32_t seq){
+  if(seq % 3 == 0){
+    event->type = EVENT_FAULT;
+    event->fault.fault = seq & 0xFF;
+    event->fault.count = seq;
+  }else{
+    event->type = EVENT_SAMPLE;
+    event->sample.timestamp = seq;
+    event->sample.setpoint = (float)(seq & 0xFFFF);
+    event->sample.output = (float)(seq % 101);
+    event->sample.temperature = (float)(seq % 977);
+  }
+}
+
+// the sequence number of a good event, -1 if its contents don't match it
+static int64_t check(const ControllerEvent *event){
+  if(event->type == EVENT_FAULT){
+    uint32_t seq = event->fault.count;
+    return(seq % 3 == 0 && event->fault.fault == (seq & 0xFF) ? seq : -1);
+  }
+  uint32_t seq = event->sample.timestamp;
+  bool good = event->type == EVENT_SAMPLE && seq % 3 != 0 && event->sample.setpoint == (float)(seq & 0xFFFF) &&
+              event->sample.output == (float)(seq % 101) && event->sample.temperature == (float)(seq % 977);
+  return(good ? seq : -1);
+}
+
+
+int main(int argc, char **argv){
+  uint32_t count = 10000000;
+  bool drop = false;
+  unsigned long spin = 0;
+
+  int opt;
+  while((opt = getopt(argc, argv, "n:ds:")) != -1){
+    switch(opt){
+      case 'n': count = strtoul(optarg, NULL, 10); break;
+      case 'd': drop = true; break;
+      case 's': spin = strtoul(optarg, NULL, 10); break;
+      default:
+        fprintf(stderr, "usage: %s [-n events] [-d] [-s consumer_spin]\n", argv[0]);
+        return(1);
+    }
+  }
+
+  uint64_t fullWaits = 0;
+  std::atomic<uint64_t> dropped(0);
+  uint64_t received = 0, corrupt = 0, outOfOrder = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  std::thread producer([&](){
+    for(uint32_t seq=0; seq<count; seq++){
+      ControllerEvent *slot;
+      while((slot = queue.claim()) == NULL){
+        if(drop){
+          break;
+        }
+        fullWaits++;
+        std::this_thread::yield();
+      }
+      if(!slot){
+        dropped++;
+        continue;
+      }
+      fill(slot, seq);
+      queue.publish();
+    }
+  });
+
+  std::thread consumer([&](){
+    int64_t last = -1;
+    volatile unsigned long sink = 0;
+    // done when the last one has arrived, or (dropping) when everything has arrived or been dropped
+    while(true){
+      const ControllerEvent *event = queue.front();
+      if(!event){
+        if(last == (int64_t)count - 1 || (drop && received + dropped >= count)){
+          break;
+        }
+        std::this_thread::yield();
+        continue;
+      }
+      int64_t seq = check(event);
+      queue.pop();
+      received++;
+      if(seq < 0){
+        corrupt++;
+      }else{
+        if(drop ? seq <= last : seq != last + 1){
+          outOfOrder++;
+        }
+        last = seq;
+      }
+      for(unsigned long i=0; i<spin; i++){
+        sink = sink + i;
+      }
+    }
+  });
+
+  producer.join();
+  consumer.join();
+  std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+
+  bool failed = corrupt || outOfOrder || received + dropped != count;
+  printf("%u events through a %u slot queue in %.3f s (%.1f M/s)\n", count, CONTROLLER_EVENTS, wall.count(), count/wall.count()/1e6);
+  printf("received %llu, dropped %llu, producer waits %llu\n", (unsigned long long)received, (unsigned long long)dropped.load(), (unsigned long long)fullWaits);
+  printf("corrupt %llu, out of order %llu: %s\n", (unsigned long long)corrupt, (unsigned long long)outOfOrder, failed ? "FAILED" : "ok");
+  return(failed ? 1 : 0);
+}
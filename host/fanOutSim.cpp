@@ -0,0 +1,201 @@
+/*
+ * Simulation of the websocket fan-out (see fanOut.h) with clients on connections of different speeds
+ * Runs the roaster's outgoing traffic at 10Hz sampling (a datapoint frame every 500 ms, a status change every
+ * 250 ms, a log line every 10 s) through a FanOut on the virtual clock, to four simulated TCP connections:
+ *   fast    drains 100 kB/s
+ *   phone   drains 400 B/s, less than the stream needs
+ *   flaky   fast, but stops for 8 s every 30 s
+ *   stuck   never drains
+ * Each connection has a TCP_SND_BUF sized send buffer. Datapoints a client is skipped for are sent later from the
+ * history (up to HISTORY_CHUNK a frame), as webServer.cpp does, so coalesced samples are delayed, not lost.
+ *
+ * For each client it reports the samples delivered and still owed at the end, messages sent and skipped, the
+ * peak queued, and when it was disconnected. Next to that, the most an unbounded queue (every message queued
+ * whatever the connection is doing) would have held.
+ *
+ * usage: fanOutSim [-t seconds=120] [-b budget=2048]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "hal.h"
+#include "../fanOut.h"
+
+#define NUM_CLIENTS 4
+#define TCP_SND_BUF 2920
+#define STEP_MS 10
+#define SAMPLES_PER_FRAME 5
+#define HISTORY_CHUNK 32
+#define DATA_HEADER_BYTES 40
+#define SAMPLE_BYTES 26
+#define STATUS_BYTES 80
+#define LOG_BYTES 60
+
+
+struct SimClient {
+  const char *name;
+  double rate;           // [bytes/s] drained when it isn't stalled
+  unsigned long stallEvery, stallFor;  // [ms] stalls for stallFor every stallEvery (0 = never)
+  bool connected;
+  double queued;         // [bytes] in the send buffer
+  double unbounded;      // [bytes] what an unbounded queue would hold
+  double peakUnbounded;
+  unsigned long owed;    // samples it was skipped for, to come from the history
+  unsigned long delivered;
+  unsigned long messages;
+  size_t peakQueued;
+  double disconnectedAt; // [s]
+};
+
+static SimClient clients[NUM_CLIENTS] = {
+  {"fast",  100000, 0,     0,    true, 0, 0, 0, 0, 0, 0, 0, -1},
+  {"phone", 400,    0,     0,    true, 0, 0, 0, 0, 0, 0, 0, -1},
+  {"flaky", 100000, 30000, 8000, true, 0, 0, 0, 0, 0, 0, 0, -1},
+  {"stuck", 0,      0,     0,    true, 0, 0, 0, 0, 0, 0, 0, -1},
+};
+
+class SimTransport : public FanOutTransport {
+ public:
+  size_t queued(uint8_t num){ return(clients[num].queued); }
+  size_t writable(uint8_t num){ return(clients[num].connected ? TCP_SND_BUF - clients[num].queued : 0); }
+  bool send(uint8_t num, uint8_t *frame, size_t length, bool binary){
+    if(!clients[num].connected || clients[num].queued + length > TCP_SND_BUF){
+      return(false);
+    }
+    clients[num].queued += length;
+    clients[num].messages++;
+    return(true);
+  }
+  void disconnect(uint8_t num){
+    clients[num].connected = false;
+    clients[num].disconnectedAt = millis()/1000.0;
+  }
+};
+
+static uint8_t frame[4096];
+
+
+static uint32_t connectedMask(){
+  uint32_t mask = 0;
+  for(uint8_t num=0; num<NUM_CLIENTS; num++){
+    if(clients[num].connected){
+      mask |= 1UL << num;
+    }
+  }
+  return(mask);
+}
+
+// every connected client's unbounded queue gets the message
+static void offer(size_t length){
+  for(uint8_t num=0; num<NUM_CLIENTS; num++){
+    if(clients[num].connected){
+      clients[num].unbounded += length;
+    }
+  }
+}
+
+
+int main(int argc, char **argv){
+  double seconds = 120;
+  size_t budget = FANOUT_BUDGET;
+  int opt;
+  while((opt = getopt(argc, argv, "t:b:")) != -1){
+    switch(opt){
+      case 't': seconds = atof(optarg); break;
+      case 'b': budget = atol(optarg); break;
+      default:
+        fprintf(stderr, "usage: fanOutSim [-t seconds] [-b budget]\n");
+        return(1);
+    }
+  }
+
+  VirtualClock clock;
+  hal::setClock(&clock);
+  SimTransport transport;
+  FanOut fanOut(&transport, NUM_CLIENTS);
+  fanOut.setBudget(budget);
+
+  unsigned long end = seconds*1000;
+  for(unsigned long t=0; t<end; t+=STEP_MS){
+    clock.advanceMillis(STEP_MS);
+
+    // the connections drain (the unbounded queue as well, to compare)
+    for(uint8_t num=0; num<NUM_CLIENTS; num++){
+      SimClient &c = clients[num];
+      bool stalled = c.stallEvery && t % c.stallEvery >= c.stallEvery - c.stallFor;
+      double drained = stalled ? 0 : c.rate*STEP_MS/1000;
+      c.queued = c.queued > drained ? c.queued - drained : 0;
+      c.unbounded = c.unbounded > drained ? c.unbounded - drained : 0;
+      if(c.unbounded > c.peakUnbounded){
+        c.peakUnbounded = c.unbounded;
+      }
+    }
+    fanOut.process();
+
+    if(t % 500 == 0){
+      // live datapoints to the clients which aren't behind
+      uint32_t live = 0;
+      for(uint8_t num=0; num<NUM_CLIENTS; num++){
+        if(clients[num].connected && clients[num].owed == 0){
+          live |= 1UL << num;
+        }
+      }
+      size_t length = DATA_HEADER_BYTES + SAMPLES_PER_FRAME*SAMPLE_BYTES;
+      offer(length);
+      uint32_t sent = fanOut.send(live, frame, length, false, FANOUT_COALESCE);
+      for(uint8_t num=0; num<NUM_CLIENTS; num++){
+        if(sent & (1UL << num)){
+          clients[num].delivered += SAMPLES_PER_FRAME;
+        }else if(clients[num].connected){
+          clients[num].owed += SAMPLES_PER_FRAME;
+        }
+      }
+    }
+    if(t % 250 == 0){
+      offer(STATUS_BYTES);
+      fanOut.send(connectedMask(), frame, STATUS_BYTES, false, FANOUT_COALESCE);
+    }
+    if(t % 10000 == 0){
+      offer(LOG_BYTES);
+      fanOut.send(connectedMask(), frame, LOG_BYTES, false, FANOUT_DROP);
+    }
+
+    // the history backfill, a chunk per loop to each client which is behind and can take it
+    for(uint8_t num=0; num<NUM_CLIENTS; num++){
+      SimClient &c = clients[num];
+      if(!c.connected || c.owed == 0){
+        continue;
+      }
+      unsigned long count = c.owed < HISTORY_CHUNK ? c.owed : HISTORY_CHUNK;
+      size_t length = DATA_HEADER_BYTES + count*SAMPLE_BYTES;
+      if(fanOut.ready(num, length) && fanOut.send(1UL << num, frame, length, false, FANOUT_COALESCE)){
+        c.owed -= count;
+        c.delivered += count;
+      }
+    }
+
+    for(uint8_t num=0; num<NUM_CLIENTS; num++){
+      if(clients[num].queued > clients[num].peakQueued){
+        clients[num].peakQueued = clients[num].queued;
+      }
+    }
+  }
+  hal::setClock(NULL);
+
+  unsigned long total = (end/500)*SAMPLES_PER_FRAME;
+  printf("%.0f s, %lu samples, budget %zu bytes, send buffer %d bytes\n", seconds, total, budget, TCP_SND_BUF);
+  printf("%-6s %9s %9s %6s %9s %12s %12s %13s\n", "client", "rate B/s", "delivered", "owed", "messages", "peak queued", "unbounded", "disconnected");
+  for(uint8_t num=0; num<NUM_CLIENTS; num++){
+    SimClient &c = clients[num];
+    char disconnected[16] = "-";
+    if(c.disconnectedAt >= 0){
+      snprintf(disconnected, sizeof(disconnected), "%.2f s", c.disconnectedAt);
+    }
+    printf("%-6s %9.0f %9lu %6lu %9lu %12zu %12.0f %13s\n", c.name, c.rate, c.delivered, c.owed, c.messages,
+           c.peakQueued, c.peakUnbounded, disconnected);
+  }
+  printf("fan-out: %lu messages, %lu bytes, %lu dropped, %lu coalesced, %lu failed, %lu disconnected, peak queued %zu\n",
+         fanOut.getMessages(), fanOut.getBytes(), fanOut.getDropped(), fanOut.getCoalesced(), fanOut.getFailed(),
+         fanOut.getDisconnects(), fanOut.getPeakQueued());
+  return(0);
+}
@@ -0,0 +1,149 @@
+#include "hal.h"
+#include <string.h>
+#include <stddef.h>
+
+
+VirtualClock::VirtualClock(uint64_t startMillis){
+  _micros = startMillis*1000;
+}
+
+unsigned long VirtualClock::millis(){
+  return((unsigned long)(uint32_t)(_micros/1000));
+}
+
+unsigned long VirtualClock::micros(){
+  return((unsigned long)(uint32_t)_micros);
+}
+
+void VirtualClock::advanceMillis(uint64_t ms){
+  advanceMicros(ms*1000);
+}
+
+void VirtualClock::advanceMicros(uint64_t us){
+  uint64_t target = _micros + us;
+  HostTimer &timer = hal::timer1();
+  while(timer.enabled && timer.callback && timer.periodUs > 0 && timer.nextFire <= target){
+    _micros = timer.nextFire;
+    if(timer.reload){
+      timer.nextFire += timer.periodUs;
+    }else{
+      timer.enabled = false;
+    }
+    timer.callback();
+  }
+  _micros = target;
+}
+
+void VirtualClock::setMicros(uint64_t us){
+  _micros = us;
+}
+
+uint64_t VirtualClock::nowMicros(){
+  return(_micros);
+}
+
+
+PinBank::PinBank(){
+  reset();
+}
+
+void PinBank::pinMode(uint8_t pin, uint8_t mode){
+  if(pin < HAL_NUM_PINS){
+    _modes[pin] = mode;
+  }
+}
+
+void PinBank::digitalWrite(uint8_t pin, uint8_t value){
+  if(pin < HAL_NUM_PINS){
+    _values[pin] = value ? 1 : 0;
+    _writes[pin]++;
+  }
+}
+
+int PinBank::digitalRead(uint8_t pin){
+  if(pin < HAL_NUM_PINS){
+    return(_values[pin]);
+  }
+  return(0);
+}
+
+unsigned long PinBank::writeCount(uint8_t pin) const{
+  if(pin < HAL_NUM_PINS){
+    return(_writes[pin]);
+  }
+  return(0);
+}
+
+void PinBank::reset(){
+  memset(_modes, 0, sizeof(_modes));
+  memset(_values, 0, sizeof(_values));
+  memset(_writes, 0, sizeof(_writes));
+}
+
+
+namespace {
+  thread_local Clock *currentClock = NULL;
+  thread_local Gpio *currentGpio = NULL;
+  thread_local ThermocoupleSource *currentThermocouple = NULL;
+  thread_local bool echoSerial = false;
+}
+
+namespace hal {
+
+  void setClock(Clock *clock){
+    currentClock = clock;
+  }
+
+  void setGpio(Gpio *gpio){
+    currentGpio = gpio;
+  }
+
+  void setThermocouple(ThermocoupleSource *source){
+    currentThermocouple = source;
+  }
+
+  Clock &clock(){
+    if(currentClock){
+      return(*currentClock);
+    }
+    return(virtualClock());
+  }
+
+  Gpio &gpio(){
+    if(currentGpio){
+      return(*currentGpio);
+    }
+    return(pinBank());
+  }
+
+  ThermocoupleSource &thermocouple(){
+    static thread_local FixedTemperature ambient;
+    if(currentThermocouple){
+      return(*currentThermocouple);
+    }
+    return(ambient);
+  }
+
+  VirtualClock &virtualClock(){
+    static thread_local VirtualClock defaultClock;
+    return(defaultClock);
+  }
+
+  HostTimer &timer1(){
+    static thread_local HostTimer timer;
+    return(timer);
+  }
+
+  PinBank &pinBank(){
+    static thread_local PinBank defaultPins;
+    return(defaultPins);
+  }
+
+  void setSerialEcho(bool echo){
+    echoSerial = echo;
+  }
+
+  bool serialEcho(){
+    return(echoSerial);
+  }
+}
@@ -0,0 +1,145 @@
+/*
+ * Host hardware abstraction layer
+ * The host build compiles the controller code against the shim Arduino headers in this directory.
+ * Those shims don't talk to hardware, they forward to the pluggable interfaces defined here:
+ *  - Clock: millis()/micros()
+ *  - Gpio: pinMode()/digitalWrite()/digitalRead()
+ *  - ThermocoupleSource: Adafruit_MAX31855::readCelsius()/readError()
+ *  - timer1 (the ESP8266 hardware timer), see HostTimer
+ *
+ * Each thread has its own set of interfaces (and its own default VirtualClock/PinBank/timer1),
+ * so independent simulations can run in parallel without sharing any state.
+ *
+ * The VirtualClock only moves when it is told to, so the loop() body can be run as fast as
+ * the host will go, with the controller seeing whatever time we want it to see.
+ */
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+
+#define HAL_NUM_PINS 17
+
+
+class Clock {
+ public:
+  virtual ~Clock() {}
+  virtual unsigned long millis() = 0;
+  virtual unsigned long micros() = 0;
+  virtual uint64_t nowMicros() = 0;  // micros() without the wrap around
+};
+
+/*
+ * Simulated time, starting at startMillis (non-zero, as the PID treats time 0 as "never run").
+ * Time is kept as a 64bit microsecond count, millis()/micros() wrap around like the real ones do.
+ * They still return unsigned long, which is 64 bits here, so times and differences of them have to be kept in
+ * uint32_t (as they are on the ESP8266) for the wrap to work out.
+ * advanceMillis()/advanceMicros() run the thread's timer1 interrupt at every expiry on the way,
+ * with the clock reading the expiry time. setMicros() just jumps.
+ */
+class VirtualClock : public Clock {
+ public:
+  VirtualClock(uint64_t startMillis = 1);
+
+  unsigned long millis();
+  unsigned long micros();
+
+  void advanceMillis(uint64_t ms);
+  void advanceMicros(uint64_t us);
+  void setMicros(uint64_t us);
+  uint64_t nowMicros();
+
+ private:
+  uint64_t _micros;
+};
+
+
+/*
+ * State of the ESP8266 timer1 as set up through the timer1_*() shims
+ */
+struct HostTimer {
+  void (*callback)(void);
+  bool enabled;
+  bool reload;       // TIM_LOOP
+  uint64_t periodUs;
+  uint64_t nextFire; // [us]
+
+  HostTimer() : callback(0), enabled(false), reload(false), periodUs(0), nextFire(0) {}
+};
+
+
+class Gpio {
+ public:
+  virtual ~Gpio() {}
+  virtual void pinMode(uint8_t pin, uint8_t mode) = 0;
+  virtual void digitalWrite(uint8_t pin, uint8_t value) = 0;
+  virtual int digitalRead(uint8_t pin) = 0;
+};
+
+/*
+ * Just remembers the last value written to each pin and counts the writes
+ */
+class PinBank : public Gpio {
+ public:
+  PinBank();
+
+  void pinMode(uint8_t pin, uint8_t mode);
+  void digitalWrite(uint8_t pin, uint8_t value);
+  int digitalRead(uint8_t pin);
+
+  unsigned long writeCount(uint8_t pin) const;
+  void reset();
+
+ private:
+  uint8_t _modes[HAL_NUM_PINS];
+  uint8_t _values[HAL_NUM_PINS];
+  unsigned long _writes[HAL_NUM_PINS];
+};
+
+
+class ThermocoupleSource {
+ public:
+  virtual ~ThermocoupleSource() {}
+  virtual double readCelsius() = 0;
+  // MAX31855 fault bits (1 open circuit, 2 short to GND, 4 short to VCC). Reads are NAN while this is non-zero.
+  virtual uint8_t readError() { return 0; }
+};
+
+/*
+ * Always reads the same temperature. Used when nothing else is plugged in.
+ */
+class FixedTemperature : public ThermocoupleSource {
+ public:
+  double temperature;
+  uint8_t fault;
+
+  FixedTemperature(double t = 20.0) : temperature(t), fault(0) {}
+  double readCelsius() { return temperature; }
+  uint8_t readError() { return fault; }
+};
+
+
+namespace hal {
+  // Plug in a new interface for the calling thread. Pass NULL to go back to the default.
+  void setClock(Clock *clock);
+  void setGpio(Gpio *gpio);
+  void setThermocouple(ThermocoupleSource *source);
+
+  // The interfaces currently in use by the calling thread
+  Clock &clock();
+  Gpio &gpio();
+  ThermocoupleSource &thermocouple();
+
+  // The calling thread's timer1
+  HostTimer &timer1();
+
+  // The per-thread defaults (used when nothing has been plugged in)
+  VirtualClock &virtualClock();
+  PinBank &pinBank();
+
+  // Echo Serial output to stdout (off by default, the controller is very chatty)
+  void setSerialEcho(bool echo);
+  bool serialEcho();
+}
+
+#endif  // HAL_H
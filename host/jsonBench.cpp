@@ -0,0 +1,231 @@
+/*
+ * Benchmark of building the outgoing websocket messages: String concatenation against JsonWriter
+ * For a full status, a chunk of text datapoints and a log line it reports the message length, and the heap
+ * allocations, bytes allocated and time per message.
+ *
+ * "String" is the way webServer.cpp built them before: a Status of Params (three Strings each) filled from a
+ * new String array of names, passed by value to status2JSON() and serialized into another String; the
+ * datapoints and logs by concatenating Strings. ArduinoJson isn't in the host build, so the status is serialized
+ * with String appends, which is what its printTo(String) does.
+ * The host String is a std::string, which doesn't allocate for strings shorter than 16 characters. The ESP8266
+ * String allocates for all of them, so the String numbers here are the least it would be on the device.
+ * "JsonWriter" is the way it is done now, into one static buffer.
+ *
+ * usage: jsonBench [iterations=100000]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <chrono>
+#include "hal.h"
+#include "../controller.h"
+#include "../params.h"
+#include "../jsonWriter.h"
+#include "../dataFrame.h"
+
+#define NUM_SAMPLES 32
+
+// count every allocation while counting is on
+static bool counting = false;
+static unsigned long allocations = 0;
+static unsigned long allocatedBytes = 0;
+
+void *operator new(size_t size){
+  if(counting){
+    allocations++;
+    allocatedBytes += size;
+  }
+  void *p = malloc(size ? size : 1);
+  if(!p){
+    throw std::bad_alloc();
+  }
+  return(p);
+}
+
+void *operator new[](size_t size){
+  return(operator new(size));
+}
+
+void operator delete(void *p) noexcept{
+  free(p);
+}
+
+void operator delete[](void *p) noexcept{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept{
+  free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept{
+  free(p);
+}
+
+
+// the old status, as it was in webServer.cpp
+typedef struct {
+  String name;
+  String dataType;
+  double doubleValue;
+  String strValue;
+  int intValue;
+} Param;
+
+typedef struct {
+  Param data[12];
+  int numParams;
+} Status;
+
+static void getStatus(Status *status){
+  status->numParams = 0;
+  int num_params = 12;
+  String params[] = {"p", "i", "d", "setpoint", "temperature", "programMode", "state", "duty_cycle", "triac_mode", "sample_interval", "thermocouple_fault", "estimator"};
+  for(int i=0; i<num_params; i++){
+    status->data[i].name = params[i];
+    status->data[i].doubleValue = paramGet(paramFind(params[i].c_str()));
+    status->data[i].dataType = "double";
+    status->numParams++;
+  }
+}
+
+static String status2JSON(Status status){
+  String statusString;
+  statusString += "{\"type\":\"status\",\"data\":{";
+  for(int i=0; i<status.numParams; i++){
+    if(i > 0){
+      statusString += ',';
+    }
+    statusString += '"';
+    statusString += status.data[i].name;
+    statusString += "\":";
+    statusString += String(status.data[i].doubleValue);
+  }
+  statusString += "}}";
+  return(statusString);
+}
+
+static size_t stringStatus(){
+  Status status;
+  getStatus(&status);
+  String statusString = status2JSON(status);
+  return(statusString.length());
+}
+
+static size_t writerStatus(JsonWriter &json){
+  static const char *names[] = {"p", "i", "d", "setpoint", "temperature", "programMode", "state", "duty_cycle", "triac_mode", "sample_interval", "thermocouple_fault", "estimator"};
+  json.clear();
+  json.beginObject();
+  json.key("type"); json.value("status");
+  json.key("data");
+  json.beginObject();
+  for(int i=0; i<12; i++){
+    json.key(names[i]);
+    json.value(paramGet(paramFind(names[i])));
+  }
+  json.endObject();
+  json.endObject();
+  return(json.length());
+}
+
+
+static DatapointFrame samples[NUM_SAMPLES];
+
+static size_t stringDatapoints(){
+  String dataString;
+  dataString.reserve(60 + NUM_SAMPLES*32);
+  dataString = String("{\"type\":\"data\",\"") + String("seq") + String("\":") + String(1234UL) + String(",\"data\":\"");
+  for(size_t i=0; i<NUM_SAMPLES; i++){
+    if(i > 0){
+      dataString += ";";
+    }
+    dataString += String(samples[i].timestamp/1000.0, 3) + String(",") + String(samples[i].setpoint) + String(",") + String(samples[i].output) + String(",") + String(samples[i].temperature);
+  }
+  dataString += "\"}";
+  return(dataString.length());
+}
+
+static size_t writerDatapoints(JsonWriter &json){
+  json.clear();
+  json.beginObject();
+  json.key("type"); json.value("data");
+  json.key("seq"); json.value(1234UL);
+  json.key("data");
+  json.beginString();
+  for(size_t i=0; i<NUM_SAMPLES; i++){
+    if(i > 0){
+      json.stringPart(";");
+    }
+    json.stringPart(samples[i].timestamp/1000.0, 3); json.stringPart(",");
+    json.stringPart(samples[i].setpoint, 2); json.stringPart(",");
+    json.stringPart(samples[i].output, 2); json.stringPart(",");
+    json.stringPart(samples[i].temperature, 2);
+  }
+  json.endString();
+  json.endObject();
+  return(json.length());
+}
+
+
+static const char *logLine = "Thermocouple fault: 1";
+
+static size_t stringLog(){
+  String log = String("{\"type\":\"log\",\"data\":\"") + String(logLine) + String("\"}");
+  return(log.length());
+}
+
+static size_t writerLog(JsonWriter &json){
+  json.clear();
+  json.beginObject();
+  json.key("type"); json.value("log");
+  json.key("data"); json.value(logLine);
+  json.endObject();
+  return(json.length());
+}
+
+
+template <typename F>
+static void bench(const char *message, const char *method, long iterations, F build){
+  size_t length = build();
+  allocations = 0;
+  allocatedBytes = 0;
+  counting = true;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(long k=0; k<iterations; k++){
+    length = build();
+  }
+  std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+  counting = false;
+  printf("%-11s %-10s %6zu %10.1f %12.1f %10.0f\n", message, method, length,
+         (double)allocations/iterations, (double)allocatedBytes/iterations, wall.count()*1e9/iterations);
+}
+
+
+int main(int argc, char **argv){
+  long iterations = argc > 1 ? atol(argv[1]) : 100000;
+  if(iterations < 1){
+    iterations = 1;
+  }
+
+  controller.setP(8);
+  controller.setI(0.1);
+  controller.setSetpoint(215.5);
+  for(size_t i=0; i<NUM_SAMPLES; i++){
+    samples[i].timestamp = 600000 + i*100;
+    samples[i].setpoint = 215.5;
+    samples[i].output = 42.37 + i*0.01;
+    samples[i].temperature = 213.25 + i*0.0625;
+  }
+
+  static char buffer[1536];
+  JsonWriter json(buffer, sizeof(buffer));
+
+  printf("%-11s %-10s %6s %10s %12s %10s\n", "message", "method", "bytes", "allocs", "heap bytes", "ns");
+  bench("status", "String", iterations, stringStatus);
+  bench("status", "JsonWriter", iterations, [&](){ return(writerStatus(json)); });
+  bench("datapoints", "String", iterations, stringDatapoints);
+  bench("datapoints", "JsonWriter", iterations, [&](){ return(writerDatapoints(json)); });
+  bench("log", "String", iterations, stringLog);
+  bench("log", "JsonWriter", iterations, [&](){ return(writerLog(json)); });
+  return(0);
+}
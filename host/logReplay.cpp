@@ -0,0 +1,160 @@
+#include "logReplay.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal.h"
+#include "../mypid.h"
+
+#define MAX_LINE_LENGTH (64 + MAX_BATCH*48)
+
+
+size_t parseDatapoints(const char *line, Datapoint *dps, size_t max){
+  const char *csv = line;
+  if(strchr(line, '{')){
+    if(!strstr(line, "\"type\":\"data\"")){
+      return(0);
+    }
+    const char *data = strstr(line, "\"data\":\"");
+    if(!data){
+      return(0);
+    }
+    csv = data + strlen("\"data\":\"");
+  }
+
+  size_t count = 0;
+  const char *p = csv;
+  while(count < max){
+    double values[4];
+    for(int i=0; i<4; i++){
+      char *end;
+      values[i] = strtod(p, &end);
+      if(end == p){
+        return(count);
+      }
+      p = end;
+      if(i < 3){
+        if(*p != ','){
+          return(count);
+        }
+        p++;
+      }
+    }
+    dps[count].timestamp = values[0];
+    dps[count].setpoint = values[1];
+    dps[count].output = values[2];
+    dps[count].temperature = values[3];
+    count++;
+    if(*p != ';'){
+      break;
+    }
+    p++;
+  }
+  return(count);
+}
+
+
+/*
+ * Read the next line, skipping any too long to be datapoints. false at the end of the file.
+ */
+static bool readLine(FILE *log, char *line, size_t size){
+  while(fgets(line, size, log)){
+    size_t len = strlen(line);
+    if(len == size - 1 && line[len - 1] != '\n'){
+      int c;
+      while((c = fgetc(log)) != EOF && c != '\n');
+      continue;
+    }
+    return(true);
+  }
+  return(false);
+}
+
+
+size_t loadLog(FILE *log, std::vector<Datapoint> *datapoints){
+  size_t added = 0;
+  char line[MAX_LINE_LENGTH];
+  while(readLine(log, line, sizeof(line))){
+    Datapoint dps[MAX_BATCH];
+    size_t count = parseDatapoints(line, dps, MAX_BATCH);
+    datapoints->insert(datapoints->end(), dps, dps + count);
+    added += count;
+  }
+  return(added);
+}
+
+
+ReplayResult replayLog(FILE *log, const ReplayGains &gains, double tolerance, DivergenceListener *listener){
+  ReplayResult result;
+  memset(&result, 0, sizeof(result));
+
+  VirtualClock clock;
+  hal::setClock(&clock);
+  PID pid(gains.p, gains.i, gains.d);
+  pid.setOutputLimits(0, 100);
+
+  // the controller clock starts wherever millis() was when it was started, it only matters that it isn't 0
+  const uint64_t startMicros = 1000000;
+  double lastTimestamp = -1;
+  double sumSquares = 0;
+  bool inDivergence = false;
+  Divergence current;
+
+  char line[MAX_LINE_LENGTH];
+  while(readLine(log, line, sizeof(line))){
+    result.lines++;
+    Datapoint dps[MAX_BATCH];
+    size_t count = parseDatapoints(line, dps, MAX_BATCH);
+    for(size_t k=0; k<count; k++){
+      const Datapoint &dp = dps[k];
+      result.datapoints++;
+
+      if(dp.timestamp < lastTimestamp){
+        pid.reset();
+        result.restarts++;
+      }
+      lastTimestamp = dp.timestamp;
+
+      clock.setMicros(startMicros + (uint64_t)llround(dp.timestamp*1e6));
+      pid.setSetpoint(dp.setpoint);
+      double output = pid.compute(dp.temperature);
+      double difference = output - dp.output;
+      sumSquares += difference*difference;
+      if(fabs(difference) > fabs(result.maxDifference)){
+        result.maxDifference = difference;
+      }
+
+      if(fabs(difference) > tolerance){
+        result.divergentSamples++;
+        if(!inDivergence){
+          inDivergence = true;
+          current.startTime = dp.timestamp;
+          current.samples = 0;
+          current.maxDifference = 0;
+        }
+        current.endTime = dp.timestamp;
+        current.samples++;
+        if(fabs(difference) > fabs(current.maxDifference)){
+          current.maxDifference = difference;
+        }
+      }else if(inDivergence){
+        inDivergence = false;
+        result.divergences++;
+        if(listener){
+          listener->divergence(current);
+        }
+      }
+    }
+  }
+  if(inDivergence){
+    result.divergences++;
+    if(listener){
+      listener->divergence(current);
+    }
+  }
+
+  if(result.datapoints > 0){
+    result.rmsDifference = sqrt(sumSquares/result.datapoints);
+  }
+  hal::setClock(NULL);
+  return(result);
+}
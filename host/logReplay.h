@@ -0,0 +1,68 @@
+/*
+ * Replay of recorded roast logs through the PID
+ * A log is whatever was captured from the websocket datapoint stream, one message per line, either
+ *   {"type":"data","data":"timestamp,setpoint,output,temperature"}
+ * (with up to MAX_BATCH datapoints in one message, separated by ;), or just the bare csv
+ * "timestamp,setpoint,output,temperature". Any other lines (status, logs, headers) are skipped.
+ *
+ * Every datapoint's temperature is fed into a PID under the virtual clock (time = the logged timestamp), with the
+ * logged setpoint, and the recomputed output is compared with the logged one. Divergences (|difference| > tolerance)
+ * are reported as runs of consecutive samples. If the timestamp goes backwards the roast was restarted,
+ * so the PID is reset, the same as Controller::start() does.
+ *
+ * The log is streamed a line at a time, so it can be any length.
+ */
+#ifndef LOGREPLAY_H
+#define LOGREPLAY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+struct Datapoint {
+  double timestamp;  // [s]
+  double setpoint;
+  double output;
+  double temperature;
+};
+
+#define MAX_BATCH 64
+
+// Parse one log line into dps (up to max of them), returns how many datapoints there were (0 if it isn't datapoints)
+size_t parseDatapoints(const char *line, Datapoint *dps, size_t max);
+
+
+struct Divergence {
+  double startTime;
+  double endTime;
+  unsigned long samples;
+  double maxDifference;  // recomputed - logged output, largest magnitude in the run
+};
+
+class DivergenceListener {
+ public:
+  virtual ~DivergenceListener() {}
+  virtual void divergence(const Divergence &d) = 0;
+};
+
+struct ReplayResult {
+  unsigned long lines;
+  unsigned long datapoints;
+  unsigned long restarts;
+  unsigned long divergentSamples;
+  unsigned long divergences;
+  double maxDifference;
+  double rmsDifference;
+};
+
+struct ReplayGains {
+  double p, i, d;
+};
+
+ReplayResult replayLog(FILE *log, const ReplayGains &gains, double tolerance, DivergenceListener *listener);
+
+// Read every datapoint in a log into memory, returns how many were added
+size_t loadLog(FILE *log, std::vector<Datapoint> *datapoints);
+
+#endif  // LOGREPLAY_H
@@ -0,0 +1,73 @@
+/*
+ * Benchmark of the loop() hot path on the host
+ * Runs controller.process() and triac.process() (the control and triac tasks) against the virtual clock,
+ * advancing time by a fixed amount per loop iteration, and reports how long it took in wall time.
+ * Each controller.process() is timed as in loop() (loopStats.h), so the histogram of the controller stage and
+ * how late the triac ran (against the virtual clock, so it is down to the loop period) are reported too.
+ *
+ * usage: loopBench [simulated_seconds=900] [loop_period_us=1000] [temperature=150]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "hal.h"
+#include "webServerHost.h"
+#include "../webServer.h"
+#include "../controller.h"
+#include "../loopStats.h"
+
+
+class CountingSink : public WebSink {
+ public:
+  unsigned long datapoints;
+  CountingSink() : datapoints(0) {}
+  void datapoint(double timestamp, double setpoint, double output, double temperature) { datapoints++; }
+};
+
+
+int main(int argc, char **argv){
+  double simSeconds = argc > 1 ? atof(argv[1]) : 900;
+  unsigned long loopPeriodUs = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000;
+  double temperature = argc > 3 ? atof(argv[3]) : 150;
+  if(loopPeriodUs == 0){
+    fprintf(stderr, "loop period must be > 0\n");
+    return(1);
+  }
+
+  VirtualClock &clock = hal::virtualClock();
+  FixedTemperature probe(temperature);
+  CountingSink sink;
+  hal::setThermocouple(&probe);
+  hal::setWebSink(&sink);
+
+  controller.setSetpoint(200);
+  controller.start();
+
+  uint64_t iterations = (uint64_t)(simSeconds*1e6/loopPeriodUs);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(uint64_t i=0; i<iterations; i++){
+    clock.advanceMicros(loopPeriodUs);
+    StageTimer timer;
+    controller.process();
+    timer.lap(STAGE_CONTROLLER);
+    controller.triac.process();
+    webserverProcess();
+  }
+  std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+
+  printf("iterations:      %llu\n", (unsigned long long)iterations);
+  printf("simulated time:  %.1f s\n", simSeconds);
+  printf("wall time:       %.4f s\n", wall.count());
+  printf("per iteration:   %.1f ns\n", wall.count()*1e9/iterations);
+  printf("speedup:         %.0fx real time\n", simSeconds/wall.count());
+  printf("datapoints sent: %lu\n", sink.datapoints);
+  printf("triac pin writes: %lu\n", hal::pinBank().writeCount(TRIAC_PIN));
+  LoopStage stages[] = {STAGE_CONTROLLER, STAGE_TRIAC_LATE};
+  for(size_t i=0; i<sizeof(stages)/sizeof(stages[0]); i++){
+    LatencyHistogram &h = loopStats.stage[stages[i]];
+    printf("%-16s p50 %lu us, p99 %lu us, max %lu us, %lu overruns of %lu\n", LoopStats::name(stages[i]),
+           (unsigned long)LoopStats::toMicros(h.percentile(0.5)), (unsigned long)LoopStats::toMicros(h.percentile(0.99)),
+           (unsigned long)LoopStats::toMicros(h.getMax()), (unsigned long)h.getOverruns(), (unsigned long)h.getCount());
+  }
+  return(0);
+}
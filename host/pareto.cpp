@@ -0,0 +1,54 @@
+#include "pareto.h"
+#include <algorithm>
+#include <limits>
+
+
+static double settling(const StepResult &r){
+  return(r.settlingTime < 0 ? std::numeric_limits<double>::infinity() : r.settlingTime);
+}
+
+static bool dominates(const StepResult &a, const StepResult &b){
+  bool noWorse = a.iae <= b.iae && a.overshoot <= b.overshoot && settling(a) <= settling(b);
+  bool better = a.iae < b.iae || a.overshoot < b.overshoot || settling(a) < settling(b);
+  return(noWorse && better);
+}
+
+namespace {
+  // lexicographic on (IAE, overshoot, settling time) so anything that dominates a result sorts before it
+  struct ByIAE {
+    const std::vector<TuningResult> &results;
+    ByIAE(const std::vector<TuningResult> &r) : results(r) {}
+    bool operator()(size_t a, size_t b) const {
+      const StepResult &ra = results[a].step;
+      const StepResult &rb = results[b].step;
+      if(ra.iae != rb.iae) return ra.iae < rb.iae;
+      if(ra.overshoot != rb.overshoot) return ra.overshoot < rb.overshoot;
+      return settling(ra) < settling(rb);
+    }
+  };
+}
+
+/*
+ * Sort by IAE first, then a result can only be dominated by something earlier in the order,
+ * and it is enough to compare against the front found so far.
+ */
+std::vector<size_t> paretoFront(const std::vector<TuningResult> &results){
+  std::vector<size_t> order(results.size());
+  for(size_t i=0; i<order.size(); i++){
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), ByIAE(results));
+
+  std::vector<size_t> front;
+  for(size_t i=0; i<order.size(); i++){
+    const StepResult &candidate = results[order[i]].step;
+    bool dominated = false;
+    for(size_t j=0; j<front.size() && !dominated; j++){
+      dominated = dominates(results[front[j]].step, candidate);
+    }
+    if(!dominated){
+      front.push_back(order[i]);
+    }
+  }
+  return(front);
+}
@@ -0,0 +1,21 @@
+/*
+ * Pareto front of PID tuning results
+ * A result is on the front if no other result is at least as good on every objective and better on one.
+ * Objectives (all minimised): IAE, overshoot, settling time (never settled counts as infinite).
+ */
+#ifndef PARETO_H
+#define PARETO_H
+
+#include <stddef.h>
+#include <vector>
+#include "stepMetrics.h"
+
+struct TuningResult {
+  double p, i, d;
+  StepResult step;
+};
+
+// indices into results of the non-dominated set, sorted by IAE
+std::vector<size_t> paretoFront(const std::vector<TuningResult> &results);
+
+#endif  // PARETO_H
@@ -0,0 +1,129 @@
+/*
+ * Downsample a roast log with LTTB (see decimator.h), the same as the device does for the history backfill
+ * Prints the picked datapoints as csv (timestamp,setpoint,output,temperature), and how well they follow the
+ * temperature: the largest difference between each logged sample and the line through the picked points,
+ * next to the same for simply taking every n'th sample.
+ *
+ * usage: roastDecimate [-n points] [-f from] [-t to] [-q] log
+ *   -n points   how many points to pick (500)
+ *   -f/-t s     the time window to pick them from (default: the whole log)
+ *   -q          don't print the points, just the summary (on stderr)
+ *   log "-" reads stdin
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "logReplay.h"
+#include "../decimator.h"
+
+
+class LogSeries : public SampleSeries {
+ public:
+  const std::vector<Datapoint> &points;
+  LogSeries(const std::vector<Datapoint> &points_in) : points(points_in) {}
+  double x(uint32_t i) const { return points[i].timestamp; }
+  double y(uint32_t i) const { return points[i].temperature; }
+};
+
+
+// largest |temperature - the line through the picked points| over [start, end)
+static double maxError(const std::vector<Datapoint> &points, const std::vector<uint32_t> &picked, uint32_t start, uint32_t end){
+  double worst = 0;
+  size_t k = 0;
+  for(uint32_t i=start; i<end; i++){
+    while(k + 1 < picked.size() && picked[k + 1] <= i){
+      k++;
+    }
+    double estimate;
+    if(k + 1 >= picked.size() || picked[k] == i){
+      estimate = points[picked[k]].temperature;
+    }else{
+      const Datapoint &a = points[picked[k]];
+      const Datapoint &b = points[picked[k + 1]];
+      estimate = a.temperature + (b.temperature - a.temperature)*(points[i].timestamp - a.timestamp)/(b.timestamp - a.timestamp);
+    }
+    worst = fmax(worst, fabs(points[i].temperature - estimate));
+  }
+  return(worst);
+}
+
+
+int main(int argc, char **argv){
+  uint32_t threshold = 500;
+  double from = -INFINITY, to = INFINITY;
+  bool quiet = false;
+
+  int opt;
+  while((opt = getopt(argc, argv, "n:f:t:q")) != -1){
+    switch(opt){
+      case 'n': threshold = strtoul(optarg, NULL, 10); break;
+      case 'f': from = atof(optarg); break;
+      case 't': to = atof(optarg); break;
+      case 'q': quiet = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-n points] [-f from] [-t to] [-q] log\n", argv[0]);
+        return(2);
+    }
+  }
+  if(optind != argc - 1){
+    fprintf(stderr, "usage: %s [-n points] [-f from] [-t to] [-q] log\n", argv[0]);
+    return(2);
+  }
+  bool useStdin = strcmp(argv[optind], "-") == 0;
+  FILE *log = useStdin ? stdin : fopen(argv[optind], "r");
+  if(!log){
+    perror(argv[optind]);
+    return(2);
+  }
+  std::vector<Datapoint> points;
+  loadLog(log, &points);
+  if(!useStdin){
+    fclose(log);
+  }
+
+  LogSeries series(points);
+  uint32_t start = lowerBound(series, 0, points.size(), from);
+  uint32_t end = lowerBound(series, start, points.size(), to);
+  if(end < points.size() && points[end].timestamp == to){
+    end++;
+  }
+
+  std::vector<uint32_t> picked;
+  picked.reserve(threshold);
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  Lttb lttb;
+  lttb.begin(start, end, threshold);
+  uint32_t index;
+  while(lttb.next(series, &index)){
+    picked.push_back(index);
+  }
+  std::chrono::duration<double> wall = std::chrono::steady_clock::now() - t0;
+
+  if(!quiet){
+    printf("timestamp,setpoint,output,temperature\n");
+    for(size_t k=0; k<picked.size(); k++){
+      const Datapoint &dp = points[picked[k]];
+      printf("%.3f,%.2f,%.2f,%.2f\n", dp.timestamp, dp.setpoint, dp.output, dp.temperature);
+    }
+  }
+
+  // every n'th sample (and the last one), for comparison
+  std::vector<uint32_t> strided;
+  if(!picked.empty()){
+    double stride = (double)(end - start - 1)/(picked.size() - 1 > 0 ? picked.size() - 1 : 1);
+    for(size_t k=0; k<picked.size(); k++){
+      strided.push_back(start + (uint32_t)llround(k*stride));
+    }
+  }
+
+  fprintf(stderr, "%u samples in the window, %zu picked in %.3f ms\n", end - start, picked.size(), wall.count()*1e3);
+  if(!picked.empty()){
+    fprintf(stderr, "max temperature error: LTTB %.2f oC, every n'th sample %.2f oC\n",
+            maxError(points, picked, start, end), maxError(points, strided, start, end));
+  }
+  return(0);
+}
@@ -0,0 +1,77 @@
+/*
+ * Batch replay of recorded roast logs (see logReplay.h)
+ * Replays each log through the PID and reports where the recomputed output diverges from the logged one.
+ * Exits with 1 if anything diverged, so it can be run over a directory of logs after every controller change.
+ *
+ * usage: roastReplay [-p P] [-i I] [-d D] [-e tolerance] [-v] log...
+ *   -p/-i/-d   PID gains to replay with (default: the controller defaults)
+ *   -e         allowed |recomputed - logged| output difference [%] (0.5)
+ *   -v         print every run of divergent samples
+ *   log "-" reads stdin
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "logReplay.h"
+#include "../controller.h"
+
+
+class PrintDivergences : public DivergenceListener {
+ public:
+  void divergence(const Divergence &d){
+    printf("    diverged %.0f-%.0f s (%lu samples), max difference %+.2f\n", d.startTime, d.endTime, d.samples, d.maxDifference);
+  }
+};
+
+
+int main(int argc, char **argv){
+  ReplayGains gains = {controller.getP(), controller.getI(), controller.getD()};
+  double tolerance = 0.5;
+  bool verbose = false;
+
+  int opt;
+  while((opt = getopt(argc, argv, "p:i:d:e:v")) != -1){
+    switch(opt){
+      case 'p': gains.p = atof(optarg); break;
+      case 'i': gains.i = atof(optarg); break;
+      case 'd': gains.d = atof(optarg); break;
+      case 'e': tolerance = atof(optarg); break;
+      case 'v': verbose = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-p P] [-i I] [-d D] [-e tolerance] [-v] log...\n", argv[0]);
+        return(2);
+    }
+  }
+  if(optind >= argc){
+    fprintf(stderr, "usage: %s [-p P] [-i I] [-d D] [-e tolerance] [-v] log...\n", argv[0]);
+    return(2);
+  }
+
+  PrintDivergences printer;
+  unsigned long totalDatapoints = 0;
+  unsigned long divergentLogs = 0;
+  int logs = argc - optind;
+  for(int k=optind; k<argc; k++){
+    bool useStdin = strcmp(argv[k], "-") == 0;
+    FILE *log = useStdin ? stdin : fopen(argv[k], "r");
+    if(!log){
+      perror(argv[k]);
+      return(2);
+    }
+    ReplayResult r = replayLog(log, gains, tolerance, verbose ? &printer : NULL);
+    if(!useStdin){
+      fclose(log);
+    }
+
+    printf("%s: %lu datapoints, %lu restarts, %lu divergent samples in %lu runs, max difference %+.2f, rms %.3f\n",
+           argv[k], r.datapoints, r.restarts, r.divergentSamples, r.divergences, r.maxDifference, r.rmsDifference);
+    totalDatapoints += r.datapoints;
+    if(r.divergentSamples > 0){
+      divergentLogs++;
+    }
+  }
+  printf("%d logs, %lu datapoints, %lu logs diverged (P=%g I=%g D=%g, tolerance %g)\n",
+         logs, totalDatapoints, divergentLogs, gains.p, gains.i, gains.d, tolerance);
+  return(divergentLogs > 0 ? 1 : 0);
+}
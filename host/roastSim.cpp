@@ -0,0 +1,283 @@
+/*
+ * Closed loop roast simulation on the host
+ * Runs the real controller (controller.process() -> PID -> TriacOutput) against the thermal plant model,
+ * under the virtual clock, and reports how well it tracked the setpoint.
+ *
+ * usage: roastSim [options]
+ *   -s setpoint     setpoint [oC] (200)
+ *   -t seconds      roast length (900)
+ *   -R rate         ramp to the setpoint at rate [oC/min] (0, a step)
+ *   -p/-i/-d gain   PID gains (default: the controller defaults)
+ *   -g schedule     schedule the PID gains on the setpoint: temperature:p:i:d,... (see mypid.h), -p/-i/-d after it
+ *                   set every band
+ *   -k gain         plant gain at full power [oC] (300)
+ *   -T tau          plant time constant [s] (90)
+ *   -L deadtime     plant dead time [s] (3)
+ *   -2              use the two-mass (air/bean) plant
+ *   -P tau          thermocouple lag behind the beans [s] (0)
+ *   -n stddev       thermocouple noise [oC] (0)
+ *   -x              bean reactions: up to 160 oC the wet beans are twice as heavy and drying takes heat, and after
+ *                   first crack at 196 oC the beans give heat out
+ *   -e              control on the estimated bean temperature (Kalman estimator) instead of the thermocouple
+ *   -l period_us    loop() period (1000)
+ *   -r ms           controller sample interval (SAMPLE_INTERVAL, FAST_SAMPLE_INTERVAL for 10Hz)
+ *   -c seconds      start the clock at this time, eg. 4290 to run across the 32 bit micros() wrap (4294.97 s)
+ *   -o file         write a csv of every controller sample to file (the websocket datapoint format, plus air and bean temperature)
+ *   -f profile      run a program mode profile instead of a fixed setpoint:
+ *                   preheat,target:ramp_rate:hold_time,... [oC, oC/min, s], eg. 150,200:30:60,225:10:120
+ *                   The roast starts as soon as it has preheated, and the run ends when it has cooled down
+ *                   (or after -t seconds if that is given).
+ *
+ * The metrics are of the true bean temperature, not what the thermocouple read. For a profile they only
+ * cover the roast itself (RAMPING and HOLD), and it prints when each state started.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <chrono>
+#include "hal.h"
+#include "webServerHost.h"
+#include "../webServer.h"
+#include "thermalPlant.h"
+#include "stepMetrics.h"
+#include "../controller.h"
+
+#define PLANT_STEP_US 10000
+#define PROFILE_MAX_TIME (4*3600)  // give up on a profile run after this long [s]
+#define REACTION_RATE 0.5          // -x drying load and exotherm [oC/s]
+#define DRYING_MASS 2              // -x heat capacity of the wet beans
+
+static const char *stateNames[] = {"OFF", "PREHEATING", "PREHEAT", "RAMPING", "HOLD", "COOLING"};
+
+
+/*
+ * Records the controller's datapoints into the metrics (and optionally a csv file)
+ */
+class MetricsSink : public WebSink {
+ public:
+  StepMetrics metrics;
+  FILE *csv;
+  ThermalPlant *plant;
+  bool roastOnly;   // only measure while the profile is running
+  double maxError;  // largest |setpoint - bean temperature| measured [oC]
+
+  MetricsSink(double steadyFrom, ThermalPlant *plant_in) : metrics(2.0, steadyFrom), csv(NULL), plant(plant_in), roastOnly(false), maxError(0) {}
+  void datapoint(double timestamp, double setpoint, double output, double temperature){
+    if(!roastOnly || controller.state == RAMPING || controller.state == HOLD){
+      metrics.add(plant->time(), setpoint, plant->beanTemperature());
+      maxError = fmax(maxError, fabs(setpoint - plant->beanTemperature()));
+    }
+    if(csv){
+      fprintf(csv, "%.3f,%.2f,%.2f,%.2f,%.2f,%.2f\n", timestamp, setpoint, output, temperature, plant->airTemperature(), plant->beanTemperature());
+    }
+  }
+};
+
+
+/*
+ * preheat,target:ramp_rate:hold_time,... into the controller's profile
+ */
+static bool parseProfile(const char *text, RoastProfile *profile){
+  char *end;
+  profile->clear();
+  profile->setName(text);
+  if(!profile->setPreheat(strtod(text, &end)) || end == text){
+    return(false);
+  }
+  while(*end == ','){
+    double target = strtod(end + 1, &end);
+    if(*end != ':'){
+      return(false);
+    }
+    double rampRate = strtod(end + 1, &end);
+    if(*end != ':'){
+      return(false);
+    }
+    double holdTime = strtod(end + 1, &end);
+    if(!profile->addStep(target, rampRate, holdTime)){
+      return(false);
+    }
+  }
+  return(*end == '\0' && profile->compile());
+}
+
+
+/*
+ * temperature:p:i:d,... into the controller's gain schedule
+ */
+static bool parseSchedule(const char *text){
+  double schedule[PID_MAX_BANDS][GAIN_BAND_FIELDS];
+  uint8_t bands = 0;
+  const char *s = text;
+  while(bands < PID_MAX_BANDS){
+    double *band = schedule[bands++];
+    int used;
+    if(sscanf(s, "%lf:%lf:%lf:%lf%n", &band[0], &band[1], &band[2], &band[3], &used) != 4){
+      return(false);
+    }
+    s += used;
+    if(*s != ','){
+      break;
+    }
+    s++;
+  }
+  return(*s == '\0' && controller.setGainSchedule(bands, schedule));
+}
+
+
+int main(int argc, char **argv){
+  double setpoint = 200;
+  double duration = 900;
+  unsigned long loopPeriodUs = 1000;
+  const char *csvFile = NULL;
+  double clockStart = 0;
+  const char *profileText = NULL;
+  bool durationSet = false;
+  PlantParams params;
+
+  int opt;
+  while((opt = getopt(argc, argv, "s:t:R:p:i:d:g:k:T:L:2P:n:xel:r:c:o:f:")) != -1){
+    switch(opt){
+      case 's': setpoint = atof(optarg); break;
+      case 't': duration = atof(optarg); durationSet = true; break;
+      case 'R': controller.ramp_rate = atof(optarg); break;
+      case 'p': controller.setP(atof(optarg)); break;
+      case 'i': controller.setI(atof(optarg)); break;
+      case 'd': controller.setD(atof(optarg)); break;
+      case 'g':
+        if(!parseSchedule(optarg)){
+          fprintf(stderr, "bad gain schedule %s, want temperature:p:i:d,... (at most %d bands, temperatures going up, gains up to %d)\n", optarg, PID_MAX_BANDS, PID_MAX_GAIN);
+          return(1);
+        }
+        break;
+      case 'k': params.gain = atof(optarg); break;
+      case 'T': params.tau = atof(optarg); break;
+      case 'L': params.deadTime = atof(optarg); break;
+      case '2': params.twoMass = true; break;
+      case 'P': params.probeTau = atof(optarg); break;
+      case 'n': params.noise = atof(optarg); break;
+      case 'x': params.dryingMass = DRYING_MASS; params.dryingLoad = REACTION_RATE; params.exotherm = REACTION_RATE; break;
+      case 'e': controller.setEstimatorMode(ESTIMATOR_KALMAN); break;
+      case 'l': loopPeriodUs = strtoul(optarg, NULL, 10); break;
+      case 'r': controller.setSampleInterval(strtoul(optarg, NULL, 10)); break;
+      case 'c': clockStart = atof(optarg); break;
+      case 'o': csvFile = optarg; break;
+      case 'f': profileText = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s [-s setpoint] [-t seconds] [-R ramp_rate] [-p P] [-i I] [-d D] [-g schedule] [-k gain] [-T tau] [-L deadtime] [-2] [-P probe_tau] [-n noise] [-x] [-e] [-l period_us] [-r sample_ms] [-c clock_start_s] [-o file.csv] [-f profile]\n", argv[0]);
+        return(1);
+    }
+  }
+  if(loopPeriodUs == 0 || loopPeriodUs > PLANT_STEP_US){
+    fprintf(stderr, "loop period must be between 1 and %d us\n", PLANT_STEP_US);
+    return(1);
+  }
+  if(profileText){
+    if(!parseProfile(profileText, &controller.profile)){
+      fprintf(stderr, "bad profile %s, want preheat,target:ramp_rate:hold_time,... (at most %d steps)\n", profileText, PROFILE_MAX_STEPS);
+      return(1);
+    }
+    if(!durationSet){
+      duration = PROFILE_MAX_TIME;
+    }
+  }
+
+  VirtualClock &clock = hal::virtualClock();
+  if(clockStart > 0){
+    clock.setMicros((uint64_t)(clockStart*1e6));
+  }
+  PinBank &pins = hal::pinBank();
+  ThermalPlant plant(params, PLANT_STEP_US/1e6);
+  MetricsSink sink(duration - 60, &plant);
+  if(csvFile){
+    sink.csv = fopen(csvFile, "w");
+    if(!sink.csv){
+      perror(csvFile);
+      return(1);
+    }
+    fprintf(sink.csv, "timestamp,setpoint,output,temperature,air_temperature,bean_temperature\n");
+  }
+  hal::setThermocouple(&plant);
+  hal::setWebSink(&sink);
+
+  if(profileText){
+    sink.roastOnly = true;
+    controller.setProgramMode(PROGRAM);
+    controller.preheat();
+  }else{
+    controller.setSetpoint(setpoint);
+    controller.start();
+  }
+  State lastState = controller.state;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  unsigned long gateOnUs = 0;
+  unsigned long stepUs = 0;
+  while(plant.time() < duration && controller.state != OFF){
+    clock.advanceMicros(loopPeriodUs);
+    controller.process();
+    if(controller.state != lastState){
+      if(profileText){
+        printf("%8.1f s  %-10s %6.1f oC\n", plant.time(), stateNames[controller.state], plant.beanTemperature());
+      }
+      lastState = controller.state;
+      // the beans go in as soon as it is ready
+      if(controller.state == PREHEAT){
+        controller.start();
+      }
+    }
+    controller.triac.process();
+    webserverProcess();
+    // the gate holds its level until the next loop iteration
+    if(pins.digitalRead(TRIAC_PIN)){
+      gateOnUs += loopPeriodUs;
+    }
+    stepUs += loopPeriodUs;
+    if(stepUs >= PLANT_STEP_US){
+      plant.step((double)gateOnUs/stepUs, pins.digitalRead(FAN_PIN));
+      gateOnUs = 0;
+      stepUs = 0;
+    }
+  }
+  std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+  if(sink.csv){
+    fclose(sink.csv);
+  }
+
+  StepResult r = sink.metrics.result();
+  double schedule[PID_MAX_BANDS][GAIN_BAND_FIELDS];
+  uint8_t bands = controller.getGainSchedule(schedule);
+  if(bands > 1){
+    printf("gain schedule:     ");
+    for(uint8_t b=0; b<bands; b++){
+      printf(" %g oC: P=%g I=%g D=%g%s", schedule[b][0], schedule[b][1], schedule[b][2], schedule[b][3], b + 1 < bands ? "," : "\n");
+    }
+  }else{
+    printf("gains:              P=%g I=%g D=%g\n", controller.getP(), controller.getI(), controller.getD());
+  }
+  printf("plant:              %s gain=%g tau=%g deadtime=%g probe lag=%g noise=%g%s\n", params.twoMass ? "two-mass" : "FOPDT", params.gain, params.tau, params.deadTime, params.probeTau, params.noise,
+         params.exotherm > 0 ? " with bean reactions" : "");
+  printf("control on:         %s\n", controller.getEstimatorMode() == ESTIMATOR_KALMAN ? "estimated bean temperature" : "thermocouple");
+  if(profileText){
+    printf("profile:            %s, %d steps in %d segments, %.0f s, sampled every %lu ms\n", profileText,
+           controller.profile.stepCount(), controller.profile.segmentCount(), controller.profile.duration(), controller.getSampleInterval());
+    printf("finished:           %s at %.0f s\n", stateNames[controller.state], plant.time());
+    printf("IAE:                %.1f oC.s (roast only)\n", r.iae);
+    printf("max error:          %.2f oC\n", sink.maxError);
+    printf("wall time:          %.1f ms\n", wall.count()*1e3);
+    return(0);
+  }
+  printf("setpoint:           %.1f oC for %.0f s, sampled every %lu ms\n", setpoint, duration, controller.getSampleInterval());
+  printf("final temperature:  %.2f oC\n", plant.beanTemperature());
+  printf("IAE:                %.1f oC.s\n", r.iae);
+  printf("overshoot:          %.2f oC\n", r.overshoot);
+  if(r.settlingTime >= 0){
+    printf("settling time:      %.1f s (+/-2 oC)\n", r.settlingTime);
+  }else{
+    printf("settling time:      never settled (+/-2 oC)\n");
+  }
+  printf("steady state error: %.2f oC (last 60 s)\n", r.steadyStateError);
+  printf("wall time:          %.1f ms\n", wall.count()*1e3);
+  return(0);
+}
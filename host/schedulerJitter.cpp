@@ -0,0 +1,216 @@
+/*
+ * Control tick jitter under web load, fixed order loop() vs the deadline scheduler
+ * Runs the real controller against the virtual clock while synthetic web work comes in: HTTP requests taking up to
+ * max_stall_ms (streaming a big file) at random times, and websocket sends of up to websocket_max_us every 50 ms.
+ * The same work arrives in both runs:
+ *  - loop:      the old loop(), controller.process(), triac.process(), server.handleClient(), webSocket.loop()
+ *               in a fixed order, each doing all of its work when it gets its turn
+ *  - scheduler: the tasks and periods in CoffeeRoaster.ino, with the HTTP work done in slices of slice_ms
+ *               and scheduler.yield() between them
+ * and it reports how far each interval between controller samples was from the sample interval, and for the
+ * scheduler how late each task started and its deadline misses.
+ *
+ * usage: schedulerJitter [-t seconds] [-i sample_interval_ms] [-s max_stall_ms] [-r stalls_per_second] [-w websocket_max_us] [-l slice_ms]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <random>
+#include "hal.h"
+#include "../controller.h"
+#include "../webServer.h"
+#include "../scheduler.h"
+#include "../latencyHistogram.h"
+
+#define LOOP_OVERHEAD_US 50    // loop() and the checks each task makes when it has nothing to do
+#define WEBSOCKET_INTERVAL_US 50000
+
+// same as CoffeeRoaster.ino
+#define CONTROL_PERIOD 1000
+#define CONTROL_DEADLINE 2000
+#define TRIAC_PERIOD 1000
+#define TRIAC_DEADLINE 2000
+#define WEBSOCKET_PERIOD 2000
+#define WEBSOCKET_DEADLINE 20000
+#define HTTP_PERIOD 5000
+#define HTTP_DEADLINE 100000
+
+
+/*
+ * The web work: when it arrives and how long it takes, the same random sequence for both runs
+ */
+class WebLoad {
+ public:
+  WebLoad(uint64_t now, double stallRate, double maxStallMs, double websocketMaxUs) :
+      _rng(1234), _uniform(0, 1), _stallRate(stallRate), _maxStallUs(maxStallMs*1000), _websocketMaxUs(websocketMaxUs) {
+    _nextStall = now + nextGap();
+    _nextWebsocket = now + WEBSOCKET_INTERVAL_US;
+  }
+
+  // the HTTP work which has arrived by now [us]
+  uint64_t http(uint64_t now){
+    uint64_t work = 0;
+    while(_nextStall <= now){
+      work += (uint64_t)(_uniform(_rng)*_maxStallUs);
+      _nextStall += nextGap();
+    }
+    return(work);
+  }
+
+  // the websocket sends due by now [us]
+  uint64_t websocket(uint64_t now){
+    uint64_t work = 0;
+    while(_nextWebsocket <= now){
+      work += (uint64_t)(_uniform(_rng)*_websocketMaxUs);
+      _nextWebsocket += WEBSOCKET_INTERVAL_US;
+    }
+    return(work);
+  }
+
+ private:
+  uint64_t nextGap(){
+    return(_stallRate > 0 ? (uint64_t)(-log(1 - _uniform(_rng))/_stallRate*1e6) + 1 : UINT64_MAX/2);
+  }
+
+  std::mt19937 _rng;
+  std::uniform_real_distribution<double> _uniform;
+  double _stallRate, _maxStallUs, _websocketMaxUs;
+  uint64_t _nextStall, _nextWebsocket;
+};
+
+
+static VirtualClock *clock_;
+static WebLoad *load;
+static uint64_t httpBacklog;
+static unsigned long sliceUs;
+static uint32_t lastSample;
+static unsigned long sampleIntervalUs;
+static LatencyHistogram tickJitter;  // [us] |interval between samples - sample interval|
+
+
+static void work(uint64_t us){
+  clock_->advanceMicros(us);
+}
+
+static void controlTask(){
+  controller.process();
+  if(controller._lastSampleMicros != lastSample){
+    uint32_t interval = controller._lastSampleMicros - lastSample;
+    tickJitter.add(interval > sampleIntervalUs ? interval - sampleIntervalUs : sampleIntervalUs - interval);
+    lastSample = controller._lastSampleMicros;
+  }
+  work(LOOP_OVERHEAD_US);
+}
+
+static void triacTask(){
+  controller.triac.process();
+}
+
+static void websocketTask(){
+  webserverProcess();
+  work(load->websocket(clock_->nowMicros()));
+}
+
+// all of it in one go
+static void httpTask(){
+  work(load->http(clock_->nowMicros()));
+}
+
+static void slicedHttpTask(){
+  httpBacklog += load->http(clock_->nowMicros());
+  while(httpBacklog){
+    uint64_t slice = httpBacklog < sliceUs ? httpBacklog : sliceUs;
+    work(slice);
+    httpBacklog -= slice;
+    scheduler.yield();
+  }
+}
+
+
+static void start(unsigned long sampleIntervalMs){
+  controller = Controller(TRIAC_PIN, FAN_PIN, sampleIntervalMs);
+  controller.setSetpoint(200);
+  controller.start();
+  lastSample = controller._lastSampleMicros;
+  sampleIntervalUs = sampleIntervalMs*1000;
+  tickJitter.clear();
+  httpBacklog = 0;
+}
+
+static void report(const char *name){
+  printf("%-9s %5lu samples, tick jitter p50 %6lu us, p99 %6lu us, max %6lu us\n", name, (unsigned long)tickJitter.getCount(),
+         (unsigned long)tickJitter.percentile(0.5), (unsigned long)tickJitter.percentile(0.99), (unsigned long)tickJitter.getMax());
+}
+
+
+int main(int argc, char **argv){
+  double seconds = 300;
+  unsigned long sampleIntervalMs = FAST_SAMPLE_INTERVAL;
+  double maxStallMs = 300;
+  double stallRate = 2;
+  double websocketMaxUs = 3000;
+  double sliceMs = 4;
+
+  int opt;
+  while((opt = getopt(argc, argv, "t:i:s:r:w:l:")) != -1){
+    switch(opt){
+      case 't': seconds = atof(optarg); break;
+      case 'i': sampleIntervalMs = strtoul(optarg, NULL, 10); break;
+      case 's': maxStallMs = atof(optarg); break;
+      case 'r': stallRate = atof(optarg); break;
+      case 'w': websocketMaxUs = atof(optarg); break;
+      case 'l': sliceMs = atof(optarg); break;
+      default:
+        fprintf(stderr, "usage: %s [-t seconds] [-i sample_interval_ms] [-s max_stall_ms] [-r stalls_per_second] [-w websocket_max_us] [-l slice_ms]\n", argv[0]);
+        return(1);
+    }
+  }
+  if(sampleIntervalMs < MIN_SAMPLE_INTERVAL || sliceMs <= 0){
+    fprintf(stderr, "the sample interval must be at least %d ms and the slice > 0\n", MIN_SAMPLE_INTERVAL);
+    return(1);
+  }
+  sliceUs = sliceMs*1000;
+
+  clock_ = &hal::virtualClock();
+  FixedTemperature probe(150);
+  hal::setThermocouple(&probe);
+  printf("%.0f s, sampling every %lu ms, %.1f requests/s of up to %.0f ms, websocket sends of up to %.0f us, %.1f ms slices\n",
+         seconds, sampleIntervalMs, stallRate, maxStallMs, websocketMaxUs, sliceMs);
+
+  // the old loop()
+  WebLoad loopLoad(clock_->nowMicros(), stallRate, maxStallMs, websocketMaxUs);
+  load = &loopLoad;
+  start(sampleIntervalMs);
+  uint64_t end = clock_->nowMicros() + (uint64_t)(seconds*1e6);
+  while(clock_->nowMicros() < end){
+    controlTask();
+    triacTask();
+    httpTask();
+    websocketTask();
+  }
+  report("loop");
+
+  // the scheduler
+  WebLoad schedulerLoad(clock_->nowMicros(), stallRate, maxStallMs, websocketMaxUs);
+  load = &schedulerLoad;
+  start(sampleIntervalMs);
+  scheduler.add("control", controlTask, PRIORITY_CONTROL, CONTROL_PERIOD, CONTROL_DEADLINE);
+  scheduler.add("triac", triacTask, PRIORITY_TRIAC, TRIAC_PERIOD, TRIAC_DEADLINE);
+  scheduler.add("websocket", websocketTask, PRIORITY_WEBSOCKET, WEBSOCKET_PERIOD, WEBSOCKET_DEADLINE);
+  scheduler.add("http", slicedHttpTask, PRIORITY_HTTP, HTTP_PERIOD, HTTP_DEADLINE);
+  end = clock_->nowMicros() + (uint64_t)(seconds*1e6);
+  while(clock_->nowMicros() < end){
+    if(!scheduler.runOnce()){
+      work(LOOP_OVERHEAD_US);
+    }
+  }
+  report("scheduler");
+  for(uint8_t t=0; t<scheduler.count(); t++){
+    Task &task = scheduler.task(t);
+    printf("  %-9s %8lu runs, late p99 %6lu us, max %6lu us, %lu deadline misses (%lu us)\n", task.name, (unsigned long)task.runs,
+           (unsigned long)task.lateness.percentile(0.99), (unsigned long)task.lateness.getMax(),
+           (unsigned long)scheduler.getMisses(t), task.deadlineUs);
+  }
+  return(0);
+}
@@ -0,0 +1,61 @@
+#include "stepMetrics.h"
+#include <math.h>
+
+
+StepMetrics::StepMetrics(double band, double steadyFrom){
+  _band = band;
+  _steadyFrom = steadyFrom;
+  reset();
+}
+
+void StepMetrics::reset(){
+  _first = true;
+  _lastTime = 0;
+  _setpoint = 0;
+  _stepTime = 0;
+  _iae = 0;
+  _maxAbove = 0;
+  _lastOutsideBand = 0;
+  _inBand = false;
+  _steadySum = 0;
+  _steadyTime = 0;
+}
+
+void StepMetrics::add(double time, double setpoint, double temperature){
+  if(_first || setpoint != _setpoint){
+    _first = false;
+    _setpoint = setpoint;
+    _stepTime = time;
+    _maxAbove = 0;
+    _lastOutsideBand = time;
+    _inBand = false;
+    _lastTime = time;
+  }
+  double dt = time - _lastTime;
+  double error = setpoint - temperature;
+  _iae += fabs(error)*dt;
+
+  if(-error > _maxAbove){
+    _maxAbove = -error;
+  }
+  if(fabs(error) > _band){
+    _lastOutsideBand = time;
+    _inBand = false;
+  }else{
+    _inBand = true;
+  }
+  if(time >= _steadyFrom){
+    _steadySum += error*dt;
+    _steadyTime += dt;
+  }
+  _lastTime = time;
+}
+
+StepResult StepMetrics::result() const{
+  StepResult r;
+  r.iae = _iae;
+  r.overshoot = _maxAbove;
+  r.settlingTime = _inBand ? _lastOutsideBand - _stepTime : -1;
+  r.steadyStateError = _steadyTime > 0 ? _steadySum/_steadyTime : 0;
+  return(r);
+}
@@ -0,0 +1,47 @@
+/*
+ * Step response / tracking quality metrics for a simulated roast
+ * Feed it (time, setpoint, temperature) samples as the simulation runs, it keeps running totals only.
+ *  - IAE: integral of |setpoint - temperature| over the run [oC.s]
+ *  - overshoot: how far the temperature went above the setpoint [oC]
+ *  - settling time: time after which the temperature stayed within +/- band of the setpoint [s]
+ *    (negative if it never settled)
+ *  - steady state error: mean (setpoint - temperature) from steadyFrom to the end [oC]
+ *
+ * Overshoot and settling time are measured from the last setpoint change.
+ */
+#ifndef STEPMETRICS_H
+#define STEPMETRICS_H
+
+struct StepResult {
+  double iae;
+  double overshoot;
+  double settlingTime;
+  double steadyStateError;
+};
+
+
+class StepMetrics {
+ public:
+  StepMetrics(double band = 2.0, double steadyFrom = 0);
+
+  void reset();
+  void add(double time, double setpoint, double temperature);
+  StepResult result() const;
+
+ private:
+  double _band;
+  double _steadyFrom;
+
+  bool _first;
+  double _lastTime;
+  double _setpoint;
+  double _stepTime;
+  double _iae;
+  double _maxAbove;
+  double _lastOutsideBand;
+  bool _inBand;
+  double _steadySum;
+  double _steadyTime;
+};
+
+#endif  // STEPMETRICS_H
@@ -0,0 +1,107 @@
+#include "thermalPlant.h"
+
+#define DRYING_START 100  // [oC]
+
+
+PlantParams::PlantParams(){
+  ambient = 20;
+  gain = 300;
+  tau = 90;
+  deadTime = 3;
+  fanOffFactor = 0.3;
+  twoMass = false;
+  airTau = 20;
+  beanTau = 60;
+  probeTau = 0;
+  noise = 0;
+  dryingEnd = 160;
+  dryingMass = 1;
+  dryingLoad = 0;
+  crackTemp = 196;
+  exotherm = 0;
+}
+
+
+ThermalPlant::ThermalPlant(const PlantParams &params, double dt) :
+    _params(params),
+    _dt(dt),
+    _noise(0, 1) {
+  size_t delaySteps = (size_t)(params.deadTime/dt + 0.5);
+  _delayLine.resize(delaySteps > 0 ? delaySteps : 1);
+  reset();
+}
+
+void ThermalPlant::reset(){
+  _time = 0;
+  _temp = _params.ambient;
+  _airTemp = _params.ambient;
+  _probeTemp = _params.ambient;
+  _rng.seed(1);
+  _noise.reset();
+  _delayPos = 0;
+  for(size_t i=0; i<_delayLine.size(); i++){
+    _delayLine[i] = 0;
+  }
+}
+
+/*
+ * Advance the model by one step with the given heater power [0, 1]
+ */
+void ThermalPlant::step(double power, bool fanOn){
+  // The delay line holds the last deadTime worth of inputs, the oldest is the one that acts now
+  double delayedPower = _delayLine[_delayPos];
+  _delayLine[_delayPos] = (float)power;
+  if(++_delayPos >= _delayLine.size()){
+    _delayPos = 0;
+  }
+  if(_params.deadTime <= 0){
+    delayedPower = power;
+  }
+
+  double transfer = fanOn ? 1.0 : _params.fanOffFactor;
+  double mass = _temp < _params.dryingEnd ? _params.dryingMass : 1;
+  double reactions = (_temp > DRYING_START && _temp < _params.dryingEnd ? -_params.dryingLoad : 0) + (_temp > _params.crackTemp ? _params.exotherm : 0);
+  if(_params.twoMass){
+    double dAir = (_params.gain*delayedPower - (_airTemp - _params.ambient)) / _params.airTau;
+    double dBean = (transfer*(_airTemp - _temp) / _params.beanTau + reactions) / mass;
+    _airTemp += dAir*_dt;
+    _temp += dBean*_dt;
+  }else{
+    double dTemp = ((transfer*_params.gain*delayedPower - (_temp - _params.ambient)) / _params.tau + reactions) / mass;
+    _temp += dTemp*_dt;
+    _airTemp = _temp;
+  }
+  if(_params.probeTau > 0){
+    _probeTemp += (_temp - _probeTemp)*_dt/_params.probeTau;
+  }else{
+    _probeTemp = _temp;
+  }
+  _time += _dt;
+}
+
+double ThermalPlant::readCelsius(){
+  if(_params.noise > 0){
+    return(_probeTemp + _params.noise*_noise(_rng));
+  }
+  return(_probeTemp);
+}
+
+double ThermalPlant::beanTemperature() const{
+  return(_temp);
+}
+
+double ThermalPlant::probeTemperature() const{
+  return(_probeTemp);
+}
+
+double ThermalPlant::airTemperature() const{
+  return(_airTemp);
+}
+
+double ThermalPlant::time() const{
+  return(_time);
+}
+
+double ThermalPlant::stepSize() const{
+  return(_dt);
+}
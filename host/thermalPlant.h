@@ -0,0 +1,81 @@
+/*
+ * Thermal model of the roaster, for closing the control loop on the host
+ * Input is the heater power (fraction of full power [0, 1], ie. the triac gate averaged over the step)
+ * and whether the fan is running. Output is the temperature the thermocouple would read.
+ *
+ * Two models:
+ *  - first order plus dead time (default):
+ *      dT/dt = (gain*power(t - deadTime) - (T - ambient)) / tau
+ *  - two-mass (air + beans), when twoMass is set:
+ *      dTair/dt  = (gain*power(t - deadTime) - (Tair - ambient)) / airTau
+ *      dTbean/dt = (Tair - Tbean) / beanTau
+ *    the thermocouple sits in the bean mass so it reads Tbean.
+ * With the fan off the heat transfer is much worse, so the gain (FOPDT) or the air->bean coupling (two-mass)
+ * is scaled by fanOffFactor.
+ * The beans themselves can take and give heat, so the loop sees different dynamics at different temperatures:
+ * until dryingEnd the water in them makes them dryingMass times heavier (so they respond that much slower) and from
+ * 100 oC evaporating it takes dryingLoad [oC/s] off the rate of rise, and after first crack (above crackTemp) the
+ * roast reactions add exotherm [oC/s]. All off by default.
+ * The thermocouple itself lags the beans by probeTau (first order), and its reading has gaussian noise
+ * of noise standard deviation added (from a fixed seed, so runs are repeatable). Both are off by default.
+ *
+ * The model is integrated with a fixed step (forward Euler), step() should always be called with the same dt.
+ * Implements ThermocoupleSource so it can be plugged straight into the HAL.
+ */
+#ifndef THERMALPLANT_H
+#define THERMALPLANT_H
+
+#include <stddef.h>
+#include <vector>
+#include <random>
+#include "hal.h"
+
+struct PlantParams {
+  double ambient;       // ambient/starting temperature [oC]
+  double gain;          // steady state temperature rise at full power [oC]
+  double tau;           // FOPDT time constant [s]
+  double deadTime;      // transport delay between the heater and the probe [s]
+  double fanOffFactor;  // heat transfer multiplier when the fan is off [0, 1]
+  bool twoMass;         // use the air/bean model instead of FOPDT
+  double airTau;        // two-mass: air time constant [s]
+  double beanTau;       // two-mass: air -> bean time constant [s]
+  double probeTau;      // thermocouple time constant [s], 0 for none
+  double noise;         // thermocouple noise standard deviation [oC]
+  double dryingEnd;     // bean temperature the drying load stops at [oC]
+  double dryingMass;    // heat capacity multiplier before the beans have dried, 1 for none
+  double dryingLoad;    // heat taken by drying [oC/s], 0 for none
+  double crackTemp;     // first crack [oC]
+  double exotherm;      // heat given off after first crack [oC/s], 0 for none
+
+  PlantParams();
+};
+
+
+class ThermalPlant : public ThermocoupleSource {
+ public:
+  ThermalPlant(const PlantParams &params, double dt);
+
+  void reset();
+  void step(double power, bool fanOn);
+
+  double readCelsius();
+  double beanTemperature() const;
+  double probeTemperature() const;
+  double airTemperature() const;
+  double time() const;
+  double stepSize() const;
+
+ private:
+  PlantParams _params;
+  double _dt;
+  double _time;
+  double _temp;     // FOPDT temperature / two-mass bean temperature
+  double _airTemp;  // two-mass air temperature
+  double _probeTemp;
+  std::mt19937 _rng;
+  std::normal_distribution<double> _noise;
+  std::vector<float> _delayLine;  // heater power history for the dead time
+  size_t _delayPos;
+};
+
+#endif  // THERMALPLANT_H
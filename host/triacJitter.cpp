@@ -0,0 +1,187 @@
+/*
+ * Triac output timing under web server load
+ * Runs a TriacOutput at a fixed duty cycle in both polled and timer mode, while loop() is randomly stalled
+ * (standing in for server.handleClient() streaming a big file), and measures what actually came out of the gate pin:
+ *  - delivered duty cycle over the whole run
+ *  - on time error per nominal PWM period (what the heater actually got in each 500 ms vs what was asked for)
+ *  - jitter of the period between rising edges
+ *  - in polled mode, how late process() ran after each period boundary (as recorded in loopStats for /metrics)
+ *
+ * usage: triacJitter [-c duty_cycle] [-t seconds] [-s max_stall_ms] [-r stalls_per_second] [-l period_us]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <random>
+#include "hal.h"
+#include "../triacOutput.h"
+#include "../loopStats.h"
+
+#define GATE_PIN D2
+
+
+/*
+ * Gpio that integrates how long the gate pin was high in each nominal period, and the rising edge intervals
+ */
+class GateRecorder : public Gpio {
+ public:
+  GateRecorder(uint64_t windowUs) : _windowUs(windowUs), _state(0), _lastChange(0), _windowStart(0), _windowOn(0),
+      _windows(0), _totalOn(0), _sumAbsError(0), _maxError(0), _expectedOn(0),
+      _lastRising(0), _risingCount(0), _sumJitter(0), _sumJitter2(0), _maxJitter(0) {}
+
+  void start(uint64_t now, double expectedOnUs){
+    _lastChange = now;
+    _windowStart = now;
+    _expectedOn = expectedOnUs;
+  }
+
+  void pinMode(uint8_t pin, uint8_t mode) {}
+  int digitalRead(uint8_t pin) { return pin == GATE_PIN ? _state : 0; }
+  void digitalWrite(uint8_t pin, uint8_t value){
+    if(pin != GATE_PIN || (value ? 1 : 0) == _state){
+      return;
+    }
+    uint64_t now = hal::clock().nowMicros();
+    accumulate(now);
+    _state = value ? 1 : 0;
+    if(_state){
+      if(_risingCount > 0){
+        double jitter = (double)(now - _lastRising) - _windowUs;
+        _sumJitter += jitter;
+        _sumJitter2 += jitter*jitter;
+        if(fabs(jitter) > _maxJitter){
+          _maxJitter = fabs(jitter);
+        }
+      }
+      _lastRising = now;
+      _risingCount++;
+    }
+  }
+
+  void finish(uint64_t now){
+    accumulate(now);
+  }
+
+  void report(const char *name, double elapsedUs){
+    unsigned long intervals = _risingCount > 1 ? _risingCount - 1 : 0;
+    double meanJitter = intervals ? _sumJitter/intervals : 0;
+    double sdJitter = intervals ? sqrt(_sumJitter2/intervals - meanJitter*meanJitter) : 0;
+    printf("%-7s delivered %6.2f%%  on time error per period: mean %7.2f ms, max %7.2f ms  period jitter: sd %7.2f ms, max %7.2f ms\n",
+           name, 100.0*_totalOn/elapsedUs, _windows ? _sumAbsError/_windows/1000 : 0, _maxError/1000, sdJitter/1000, _maxJitter/1000);
+  }
+
+ private:
+  // add the time since the last change to the windows it covers
+  void accumulate(uint64_t now){
+    while(now >= _windowStart + _windowUs){
+      uint64_t windowEnd = _windowStart + _windowUs;
+      if(_state){
+        _windowOn += windowEnd - _lastChange;
+        _totalOn += windowEnd - _lastChange;
+      }
+      double error = fabs((double)_windowOn - _expectedOn);
+      _sumAbsError += error;
+      if(error > _maxError){
+        _maxError = error;
+      }
+      _windows++;
+      _windowOn = 0;
+      _windowStart = windowEnd;
+      _lastChange = windowEnd;
+    }
+    if(_state){
+      _windowOn += now - _lastChange;
+      _totalOn += now - _lastChange;
+    }
+    _lastChange = now;
+  }
+
+  uint64_t _windowUs;
+  int _state;
+  uint64_t _lastChange;
+  uint64_t _windowStart;
+  uint64_t _windowOn;
+  unsigned long _windows;
+  uint64_t _totalOn;
+  double _sumAbsError;
+  double _maxError;
+  double _expectedOn;
+  uint64_t _lastRising;
+  unsigned long _risingCount;
+  double _sumJitter, _sumJitter2, _maxJitter;
+};
+
+
+static void run(TriacDrive drive, double duty, double seconds, double maxStallMs, double stallRate, unsigned long loopPeriodUs){
+  VirtualClock clock;
+  GateRecorder gate(TRIAC_PWM_PERIOD_MS*1000ULL);
+  hal::setClock(&clock);
+  hal::setGpio(&gate);
+
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  double stallProbability = stallRate*loopPeriodUs/1e6;
+
+  TriacOutput triac(GATE_PIN);
+  triac.setDrive(drive);
+  triac.setDutyCycle(duty);
+  gate.start(clock.nowMicros(), duty/100.0*TRIAC_PWM_PERIOD_MS*1000);
+  uint64_t startUs = clock.nowMicros();
+  loopStats.clear();
+  triac.enable();
+
+  uint64_t endUs = startUs + (uint64_t)(seconds*1e6);
+  while(clock.nowMicros() < endUs){
+    triac.process();
+    uint64_t busyUs = loopPeriodUs;
+    if(uniform(rng) < stallProbability){
+      busyUs += (uint64_t)(uniform(rng)*maxStallMs*1000);
+    }
+    clock.advanceMicros(busyUs);
+  }
+  triac.disable();
+  gate.finish(clock.nowMicros());
+  gate.report(drive == TRIAC_TIMER ? "timer" : "polled", clock.nowMicros() - startUs);
+  LatencyHistogram &late = loopStats.stage[STAGE_TRIAC_LATE];
+  if(late.getCount()){
+    printf("        late at a boundary: p50 %lu us, p99 %lu us, max %lu us, %lu of %lu by more than a half cycle\n",
+           (unsigned long)LoopStats::toMicros(late.percentile(0.5)), (unsigned long)LoopStats::toMicros(late.percentile(0.99)),
+           (unsigned long)LoopStats::toMicros(late.getMax()), (unsigned long)late.getOverruns(), (unsigned long)late.getCount());
+  }
+
+  hal::setClock(NULL);
+  hal::setGpio(NULL);
+}
+
+
+int main(int argc, char **argv){
+  double duty = 30;
+  double seconds = 600;
+  double maxStallMs = 300;
+  double stallRate = 2;
+  unsigned long loopPeriodUs = 1000;
+
+  int opt;
+  while((opt = getopt(argc, argv, "c:t:s:r:l:")) != -1){
+    switch(opt){
+      case 'c': duty = atof(optarg); break;
+      case 't': seconds = atof(optarg); break;
+      case 's': maxStallMs = atof(optarg); break;
+      case 'r': stallRate = atof(optarg); break;
+      case 'l': loopPeriodUs = strtoul(optarg, NULL, 10); break;
+      default:
+        fprintf(stderr, "usage: %s [-c duty_cycle] [-t seconds] [-s max_stall_ms] [-r stalls_per_second] [-l period_us]\n", argv[0]);
+        return(1);
+    }
+  }
+  if(loopPeriodUs == 0){
+    fprintf(stderr, "loop period must be > 0\n");
+    return(1);
+  }
+
+  printf("duty cycle %.1f%%, %.0f s, loop every %lu us, %.1f stalls/s of up to %.0f ms\n", duty, seconds, loopPeriodUs, stallRate, maxStallMs);
+  run(TRIAC_POLLED, duty, seconds, maxStallMs, stallRate, loopPeriodUs);
+  run(TRIAC_TIMER, duty, seconds, maxStallMs, stallRate, loopPeriodUs);
+  return(0);
+}
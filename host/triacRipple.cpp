@@ -0,0 +1,104 @@
+/*
+ * Temperature ripple of burst vs sigma-delta triac output
+ * Drives the thermal plant open loop through a TriacOutput (timer driven) at a fixed duty cycle, once with each
+ * distribution, so the average power is the same, and measures the peak to peak ripple of the probe (and air)
+ * temperature once it has settled.
+ *
+ * usage: triacRipple [-t seconds] [-2] [-T tau] [-a air_tau] duty_cycle...
+ *   default duty cycles 5 10 20 30 50
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include "hal.h"
+#include "thermalPlant.h"
+#include "../triacOutput.h"
+
+#define GATE_PIN D2
+#define PLANT_STEP_US TRIAC_TICK_US
+
+
+struct Ripple {
+  double mean;
+  double probe;  // peak to peak [oC]
+  double air;
+};
+
+/*
+ * Run for seconds, measure over the last 10% (the plant has to settle to well under the ripple first)
+ */
+static Ripple run(TriacDistribution distribution, double duty, double seconds, const PlantParams &params){
+  VirtualClock clock;
+  PinBank pins;
+  hal::setClock(&clock);
+  hal::setGpio(&pins);
+
+  ThermalPlant plant(params, PLANT_STEP_US/1e6);
+  TriacOutput triac(GATE_PIN);
+  triac.setDrive(TRIAC_TIMER);
+  triac.setDistribution(distribution);
+  triac.setDutyCycle(duty);
+  triac.enable();
+
+  double measureFrom = seconds*0.9;
+  double minProbe = 1e9, maxProbe = -1e9, minAir = 1e9, maxAir = -1e9, sum = 0;
+  unsigned long n = 0;
+  while(plant.time() < seconds){
+    clock.advanceMicros(PLANT_STEP_US);
+    plant.step(pins.digitalRead(GATE_PIN), true);
+    if(plant.time() >= measureFrom){
+      double probe = plant.readCelsius();
+      double air = plant.airTemperature();
+      if(probe < minProbe) minProbe = probe;
+      if(probe > maxProbe) maxProbe = probe;
+      if(air < minAir) minAir = air;
+      if(air > maxAir) maxAir = air;
+      sum += probe;
+      n++;
+    }
+  }
+  triac.disable();
+  hal::setClock(NULL);
+  hal::setGpio(NULL);
+
+  Ripple r = {sum/n, maxProbe - minProbe, maxAir - minAir};
+  return(r);
+}
+
+
+int main(int argc, char **argv){
+  double seconds = 1800;
+  PlantParams params;
+
+  int opt;
+  while((opt = getopt(argc, argv, "t:2T:a:")) != -1){
+    switch(opt){
+      case 't': seconds = atof(optarg); break;
+      case '2': params.twoMass = true; break;
+      case 'T': params.tau = atof(optarg); break;
+      case 'a': params.airTau = atof(optarg); break;
+      default:
+        fprintf(stderr, "usage: %s [-t seconds] [-2] [-T tau] [-a air_tau] duty_cycle...\n", argv[0]);
+        return(1);
+    }
+  }
+  std::vector<double> duties;
+  for(int k=optind; k<argc; k++){
+    duties.push_back(atof(argv[k]));
+  }
+  if(duties.empty()){
+    double defaults[] = {5, 10, 20, 30, 50};
+    duties.assign(defaults, defaults + 5);
+  }
+
+  printf("%s plant, ripple measured over the last %.0f s\n", params.twoMass ? "two-mass" : "FOPDT", seconds*0.1);
+  printf("duty  |  burst: mean    probe p-p  air p-p  |  sigma-delta: mean    probe p-p  air p-p\n");
+  for(size_t k=0; k<duties.size(); k++){
+    Ripple burst = run(TRIAC_BURST, duties[k], seconds, params);
+    Ripple sd = run(TRIAC_SIGMA_DELTA, duties[k], seconds, params);
+    printf("%4.0f%% |        %6.2f  %9.3f  %7.3f  |               %6.2f  %9.3f  %7.3f\n",
+           duties[k], burst.mean, burst.probe, burst.air, sd.mean, sd.probe, sd.air);
+  }
+  return(0);
+}
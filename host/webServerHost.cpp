@@ -0,0 +1,67 @@
+#include "webServerHost.h"
+#include "../webServer.h"
+#include "../controllerEvents.h"
+#include <math.h>
+
+
+namespace {
+  thread_local WebSink *currentSink = NULL;
+}
+
+void hal::setWebSink(WebSink *sink){
+  currentSink = sink;
+}
+
+/*
+ * Hand what the controller has published to the sink, there is no batching on the host
+ * State changes and faults have no sink, they are just taken off the queue.
+ */
+void webserverProcess(){
+  ControllerEventQueue &events = controllerEvents();
+  ControllerEvent *event;
+  while((event = events.front()) != NULL){
+    if(currentSink && event->type == EVENT_SAMPLE){
+      currentSink->datapoint(event->sample.timestamp/1000.0, event->sample.setpoint, event->sample.output, event->sample.temperature);
+    }else if(currentSink && event->type == EVENT_TEMPERATURE){
+      currentSink->data("temperature", event->temperature.measured);
+      if(!isnan(event->temperature.estimated)){
+        currentSink->data("estimated_temperature", event->temperature.estimated);
+      }
+    }
+    events.pop();
+  }
+}
+
+void webserverLog(uint8_t level, const char *log){
+  if(currentSink){
+    currentSink->log(log);
+  }
+}
+
+
+// nothing is published on the host, these are just kept so they read back
+namespace {
+  unsigned long publishInterval = 0;
+  size_t publishBatch = 1;
+  FanOut fanOut(NULL, 0);
+}
+
+void webserverSetPublishInterval(unsigned long interval){
+  publishInterval = interval;
+}
+
+unsigned long webserverGetPublishInterval(){
+  return(publishInterval);
+}
+
+void webserverSetPublishBatch(size_t batchSize){
+  publishBatch = batchSize;
+}
+
+size_t webserverGetPublishBatch(){
+  return(publishBatch);
+}
+
+FanOut &webserverFanOut(){
+  return(fanOut);
+}
@@ -0,0 +1,24 @@
+/*
+ * Host replacement for the web layer
+ * webserverProcess() takes the controller's events (controllerEvents.h) and forwards them to a pluggable
+ * WebSink (per thread), so the host tools can see what the controller would have sent to the browser.
+ * Call it after controller.process(). Nothing is sent anywhere if no sink is plugged in.
+ */
+#ifndef WEBSERVERHOST_H
+#define WEBSERVERHOST_H
+
+#include <Arduino.h>
+
+class WebSink {
+ public:
+  virtual ~WebSink() {}
+  virtual void datapoint(double timestamp, double setpoint, double output, double temperature) {}
+  virtual void data(const String &name, double value) {}
+  virtual void log(const String &message) {}
+};
+
+namespace hal {
+  void setWebSink(WebSink *sink);
+}
+
+#endif  // WEBSERVERHOST_H
@@ -0,0 +1,116 @@
+#include "workStealingPool.h"
+
+
+WorkStealingPool::WorkStealingPool(unsigned numThreads) :
+    _pending(0),
+    _queued(0),
+    _steals(0),
+    _next(0),
+    _stopping(false) {
+  if(numThreads == 0){
+    numThreads = std::thread::hardware_concurrency();
+  }
+  if(numThreads == 0){
+    numThreads = 1;
+  }
+  for(unsigned i=0; i<numThreads; i++){
+    _queues.push_back(new Queue());
+  }
+  for(unsigned i=0; i<numThreads; i++){
+    _threads.push_back(std::thread(&WorkStealingPool::run, this, i));
+  }
+}
+
+WorkStealingPool::~WorkStealingPool(){
+  wait();
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _stopping = true;
+  }
+  _workAvailable.notify_all();
+  for(size_t i=0; i<_threads.size(); i++){
+    _threads[i].join();
+  }
+  for(size_t i=0; i<_queues.size(); i++){
+    delete _queues[i];
+  }
+}
+
+void WorkStealingPool::submit(const Task &task){
+  Queue *queue = _queues[_next++ % _queues.size()];
+  _pending++;
+  {
+    // counted before it is visible so _queued never goes below the number of tasks in the deques.
+    // Taking the lock means a worker can't miss the wakeup between checking _queued and sleeping.
+    std::lock_guard<std::mutex> guard(_lock);
+    _queued++;
+  }
+  {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    queue->tasks.push_back(task);
+  }
+  _workAvailable.notify_one();
+}
+
+void WorkStealingPool::wait(){
+  std::unique_lock<std::mutex> guard(_lock);
+  while(_pending > 0){
+    _allDone.wait(guard);
+  }
+}
+
+unsigned WorkStealingPool::size() const{
+  return(_threads.size());
+}
+
+unsigned long WorkStealingPool::steals() const{
+  return(_steals);
+}
+
+bool WorkStealingPool::popLocal(unsigned index, Task &task){
+  Queue *queue = _queues[index];
+  std::lock_guard<std::mutex> guard(queue->lock);
+  if(queue->tasks.empty()){
+    return(false);
+  }
+  task = queue->tasks.back();
+  queue->tasks.pop_back();
+  return(true);
+}
+
+bool WorkStealingPool::steal(unsigned index, Task &task){
+  for(size_t i=1; i<_queues.size(); i++){
+    Queue *victim = _queues[(index + i) % _queues.size()];
+    std::lock_guard<std::mutex> guard(victim->lock);
+    if(!victim->tasks.empty()){
+      task = victim->tasks.front();
+      victim->tasks.pop_front();
+      _steals++;
+      return(true);
+    }
+  }
+  return(false);
+}
+
+void WorkStealingPool::run(unsigned index){
+  while(true){
+    Task task;
+    if(popLocal(index, task) || steal(index, task)){
+      _queued--;
+      task();
+      if(--_pending == 0){
+        std::lock_guard<std::mutex> guard(_lock);
+        _allDone.notify_all();
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> guard(_lock);
+    while(_queued == 0 && !_stopping){
+      _workAvailable.wait(guard);
+    }
+    if(_stopping && _queued == 0){
+      return;
+    }
+  }
+}
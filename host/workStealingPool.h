@@ -0,0 +1,56 @@
+/*
+ * Work stealing thread pool for the host tools
+ * Each worker has its own task deque. Workers take from the back of their own deque and,
+ * when it is empty, steal from the front of the other workers' deques, so uneven tasks still keep every core busy.
+ * submit() hands tasks out round robin; wait() blocks until every submitted task has finished.
+ * Tasks must not throw.
+ */
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class WorkStealingPool {
+ public:
+  typedef std::function<void()> Task;
+
+  // numThreads = 0 uses one thread per core
+  WorkStealingPool(unsigned numThreads = 0);
+  ~WorkStealingPool();
+
+  void submit(const Task &task);
+  void wait();
+  unsigned size() const;
+  unsigned long steals() const;
+
+ private:
+  struct Queue {
+    std::mutex lock;
+    std::deque<Task> tasks;
+  };
+
+  void run(unsigned index);
+  bool popLocal(unsigned index, Task &task);
+  bool steal(unsigned index, Task &task);
+
+  std::vector<Queue*> _queues;
+  std::vector<std::thread> _threads;
+  std::mutex _lock;
+  std::condition_variable _workAvailable;
+  std::condition_variable _allDone;
+  std::atomic<size_t> _pending;    // submitted but not finished
+  std::atomic<size_t> _queued;     // submitted but not started
+  std::atomic<unsigned long> _steals;
+  std::atomic<unsigned> _next;
+  bool _stopping;
+};
+
+#endif  // WORKSTEALINGPOOL_H
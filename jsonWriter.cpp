@@ -0,0 +1,254 @@
+#include "jsonWriter.h"
+#include <math.h>
+
+
+JsonWriter::JsonWriter(char *buffer, size_t size) : _buffer(buffer), _size(size) {
+  clear();
+}
+
+
+/*
+ * Start again at the beginning of the buffer
+ */
+void JsonWriter::clear(){
+  _length = 0;
+  _overflowed = false;
+  _depth = 0;
+  _hasItems = 0;
+  _afterKey = false;
+  if(_size > 0){
+    _buffer[0] = '\0';
+  }
+}
+
+
+void JsonWriter::beginObject(){
+  open('{');
+}
+
+void JsonWriter::endObject(){
+  close('}');
+}
+
+void JsonWriter::beginArray(){
+  open('[');
+}
+
+void JsonWriter::endArray(){
+  close(']');
+}
+
+
+void JsonWriter::key(const char *name){
+  separator();
+  put('"');
+  putEscaped(name);
+  puts("\":");
+  _afterKey = true;
+}
+
+
+void JsonWriter::value(const char *str){
+  beginString();
+  putEscaped(str);
+  endString();
+}
+
+void JsonWriter::value(double number, uint8_t decimals){
+  separator();
+  putDouble(number, decimals);
+}
+
+void JsonWriter::value(int number){
+  value((long)number);
+}
+
+void JsonWriter::value(unsigned int number){
+  value((unsigned long)number);
+}
+
+void JsonWriter::value(long number){
+  separator();
+  if(number < 0){
+    put('-');
+    // negate as unsigned, so LONG_MIN works
+    putUnsigned(0ULL - (unsigned long long)number);
+  }else{
+    putUnsigned(number);
+  }
+}
+
+void JsonWriter::value(unsigned long number){
+  separator();
+  putUnsigned(number);
+}
+
+void JsonWriter::value(bool b){
+  separator();
+  puts(b ? "true" : "false");
+}
+
+void JsonWriter::null(){
+  separator();
+  puts("null");
+}
+
+
+void JsonWriter::beginString(){
+  separator();
+  put('"');
+}
+
+void JsonWriter::stringPart(const char *str){
+  putEscaped(str);
+}
+
+// NaN is written as nan inside a string, it isn't JSON there
+void JsonWriter::stringPart(double number, uint8_t decimals){
+  if(isnan(number)){
+    puts("nan");
+  }else{
+    putDouble(number, decimals);
+  }
+}
+
+void JsonWriter::endString(){
+  put('"');
+}
+
+
+const char *JsonWriter::c_str() const{
+  return(_buffer);
+}
+
+size_t JsonWriter::length() const{
+  return(_length);
+}
+
+bool JsonWriter::overflowed() const{
+  return(_overflowed);
+}
+
+
+/*
+ * A comma if this isn't the first thing in the object/array (and not the value after a key)
+ */
+void JsonWriter::separator(){
+  if(_afterKey){
+    _afterKey = false;
+    return;
+  }
+  if(_depth > 0 && _depth <= JSON_MAX_DEPTH){
+    uint32_t bit = 1UL << (_depth - 1);
+    if(_hasItems & bit){
+      put(',');
+    }
+    _hasItems |= bit;
+  }
+}
+
+void JsonWriter::open(char bracket){
+  separator();
+  put(bracket);
+  _depth++;
+  if(_depth <= JSON_MAX_DEPTH){
+    _hasItems &= ~(1UL << (_depth - 1));
+  }else{
+    _overflowed = true;
+  }
+}
+
+void JsonWriter::close(char bracket){
+  if(_depth > 0){
+    _depth--;
+  }
+  put(bracket);
+}
+
+
+void JsonWriter::put(char c){
+  // keep room for the terminating nul
+  if(_length + 1 >= _size){
+    _overflowed = true;
+    return;
+  }
+  _buffer[_length++] = c;
+  _buffer[_length] = '\0';
+}
+
+void JsonWriter::puts(const char *str){
+  while(*str){
+    put(*str++);
+  }
+}
+
+void JsonWriter::putEscaped(const char *str){
+  static const char hex[] = "0123456789abcdef";
+  for(; *str; str++){
+    unsigned char c = *str;
+    switch(c){
+      case '"':  puts("\\\""); break;
+      case '\\': puts("\\\\"); break;
+      case '\n': puts("\\n"); break;
+      case '\r': puts("\\r"); break;
+      case '\t': puts("\\t"); break;
+      case '\b': puts("\\b"); break;
+      case '\f': puts("\\f"); break;
+      default:
+        if(c < 0x20){
+          puts("\\u00");
+          put(hex[c >> 4]);
+          put(hex[c & 0xf]);
+        }else{
+          // UTF-8 goes through as it is
+          put(c);
+        }
+    }
+  }
+}
+
+void JsonWriter::putUnsigned(unsigned long long number){
+  char digits[20];
+  uint8_t n = 0;
+  do{
+    digits[n++] = '0' + number%10;
+    number /= 10;
+  }while(number > 0);
+  while(n > 0){
+    put(digits[--n]);
+  }
+}
+
+/*
+ * Fixed point, rounded to decimals places, trailing zeros dropped
+ * Only for the sort of numbers the roaster has: anything too big to be done with a 64 bit integer is null
+ */
+void JsonWriter::putDouble(double number, uint8_t decimals){
+  if(decimals > 9){
+    decimals = 9;
+  }
+  unsigned long long scale = 1;
+  for(uint8_t i=0; i<decimals; i++){
+    scale *= 10;
+  }
+  double scaled = fabs(number)*scale + 0.5;
+  if(isnan(number) || scaled >= 1.8e19){
+    puts("null");
+    return;
+  }
+  unsigned long long fixed = (unsigned long long)scaled;
+  if(number < 0 && fixed > 0){
+    put('-');
+  }
+  putUnsigned(fixed/scale);
+  unsigned long long fraction = fixed%scale;
+  if(fraction == 0){
+    return;
+  }
+  put('.');
+  // the leading zeros, then the digits without the trailing ones
+  for(unsigned long long digit = scale/10; digit > 0 && fraction > 0; digit /= 10){
+    put('0' + fraction/digit);
+    fraction %= digit;
+  }
+}
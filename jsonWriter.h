@@ -0,0 +1,74 @@
+/*
+ * Streaming JSON writer
+ * Formats JSON straight into a buffer the caller owns, so building a message does no heap allocation.
+ * Commas, quotes and escaping are taken care of; the caller just says what comes next:
+ *
+ *   JsonWriter json(buf, sizeof(buf));
+ *   json.beginObject();
+ *   json.key("type"); json.value("status");
+ *   json.endObject();
+ *
+ * If the buffer fills up the rest is dropped and overflowed() is true, the output is always nul terminated.
+ * Numbers: NaN and infinity are written as null (JSON has no NaN), doubles to the given number of decimal
+ * places with trailing zeros dropped (10.50 -> 10.5, 3.00 -> 3).
+ * Nesting is limited to JSON_MAX_DEPTH.
+ */
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define JSON_MAX_DEPTH 32
+#define JSON_DECIMALS 4
+
+class JsonWriter {
+ public:
+  JsonWriter(char *buffer, size_t size);
+
+  void beginObject();
+  void endObject();
+  void beginArray();
+  void endArray();
+  void key(const char *name);
+
+  void value(const char *str);
+  void value(double number, uint8_t decimals = JSON_DECIMALS);
+  void value(int number);
+  void value(unsigned int number);
+  void value(long number);
+  void value(unsigned long number);
+  void value(bool b);
+  void null();
+
+  // the pieces of a string value, for building one up (eg. a list of datapoints)
+  void beginString();
+  void stringPart(const char *str);
+  void stringPart(double number, uint8_t decimals = JSON_DECIMALS);
+  void endString();
+
+  const char *c_str() const;
+  size_t length() const;
+  bool overflowed() const;
+  void clear();
+
+ private:
+  void separator();
+  void open(char bracket);
+  void close(char bracket);
+  void put(char c);
+  void puts(const char *str);
+  void putEscaped(const char *str);
+  void putUnsigned(unsigned long long number);
+  void putDouble(double number, uint8_t decimals);
+
+  char *_buffer;
+  size_t _size;
+  size_t _length;
+  bool _overflowed;
+  uint8_t _depth;
+  uint32_t _hasItems;  // bit n: there is already something at depth n, so the next one needs a comma
+  bool _afterKey;
+};
+
+#endif  // JSONWRITER_H
@@ -0,0 +1,102 @@
+#include "latencyHistogram.h"
+
+
+LatencyHistogram::LatencyHistogram(){
+  _limit = 0;
+  clear();
+}
+
+
+void LatencyHistogram::add(uint32_t cycles){
+  _buckets[bucket(cycles)]++;
+  _count++;
+  if(cycles > _max){
+    _max = cycles;
+  }
+  if(_limit && cycles > _limit){
+    _overruns++;
+  }
+}
+
+
+void LatencyHistogram::clear(){
+  for(uint8_t b=0; b<HISTOGRAM_BUCKETS; b++){
+    _buckets[b] = 0;
+  }
+  _count = 0;
+  _max = 0;
+  _overruns = 0;
+}
+
+
+void LatencyHistogram::setLimit(uint32_t cycles){
+  _limit = cycles;
+}
+
+uint32_t LatencyHistogram::getLimit(){
+  return(_limit);
+}
+
+uint32_t LatencyHistogram::getCount(){
+  return(_count);
+}
+
+uint32_t LatencyHistogram::getMax(){
+  return(_max);
+}
+
+uint32_t LatencyHistogram::getOverruns(){
+  return(_overruns);
+}
+
+
+/*
+ * The duration p (0..1) of them were no longer than, to the top of its bucket but no more than the max
+ * 0 if there aren't any.
+ */
+uint32_t LatencyHistogram::percentile(double p){
+  if(_count == 0){
+    return(0);
+  }
+  uint32_t target = (uint32_t)(p*_count + 0.999999);
+  if(target < 1){
+    target = 1;
+  }
+  uint32_t seen = 0;
+  for(uint8_t b=0; b<HISTOGRAM_BUCKETS; b++){
+    seen += _buckets[b];
+    if(seen >= target){
+      uint32_t top = bucketTop(b);
+      return(top < _max ? top : _max);
+    }
+  }
+  return(_max);
+}
+
+
+/*
+ * 0 and 1 have their own buckets. After that bucket 2n is [2^n, 1.5*2^n), 2n+1 is [1.5*2^n, 2^(n+1)).
+ */
+uint8_t LatencyHistogram::bucket(uint32_t cycles){
+  if(cycles < 2){
+    return(cycles);
+  }
+  uint8_t octave = 31 - __builtin_clz(cycles);
+  uint8_t b = 2*octave + ((cycles >> (octave - 1)) & 1);
+  return(b < HISTOGRAM_BUCKETS ? b : HISTOGRAM_BUCKETS - 1);
+}
+
+/*
+ * The largest duration in bucket b
+ */
+uint32_t LatencyHistogram::bucketTop(uint8_t b){
+  if(b < 2){
+    return(b);
+  }
+  if(b >= HISTOGRAM_BUCKETS - 1){
+    return(UINT32_MAX);
+  }
+  uint8_t octave = b/2;
+  uint32_t half = 1UL << (octave - 1);
+  return((1UL << octave) + (b & 1)*half + half - 1);
+}
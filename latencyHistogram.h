@@ -0,0 +1,42 @@
+/*
+ * Fixed bucket latency histogram
+ * Counts durations (CPU cycles, or us) into buckets two to an octave (each bucket is at most ~41% wide), so adding one
+ * is a count-leading-zeros and an increment. Percentiles come from the buckets, as the top of the bucket they
+ * fall in (so they are never under-reported), the max is exact.
+ * An overrun is a duration over the limit (0 = no limit). percentile() takes a fraction (0.99 for p99).
+ *
+ * HISTOGRAM_BUCKETS covers up to 2^28 cycles (3.4 s at 80MHz), anything longer goes in the last bucket.
+ */
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <stdint.h>
+
+#define HISTOGRAM_BUCKETS 56
+
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  void add(uint32_t cycles);
+  void clear();
+  void setLimit(uint32_t cycles);
+  uint32_t getLimit();
+
+  uint32_t getCount();
+  uint32_t getMax();
+  uint32_t getOverruns();
+  uint32_t percentile(double p);
+
+  static uint8_t bucket(uint32_t cycles);
+  static uint32_t bucketTop(uint8_t bucket);
+
+ private:
+  uint32_t _buckets[HISTOGRAM_BUCKETS];
+  uint32_t _count;
+  uint32_t _max;
+  uint32_t _overruns;
+  uint32_t _limit;
+};
+
+#endif  // LATENCYHISTOGRAM_H
@@ -0,0 +1,90 @@
+#include "logger.h"
+#include <Arduino.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "spscRing.h"
+
+struct LogLine {
+  uint8_t level;
+  char text[LOG_LINE_LENGTH];
+};
+
+// the host tools run a controller per thread, so like the rest of the host hal each thread has its own log
+#ifdef HOST_BUILD
+#define LOG_STATE static thread_local
+#else
+#define LOG_STATE static
+#endif
+
+LOG_STATE SpscRing<LogLine, LOG_LINES> lines;
+LOG_STATE uint32_t dropped = 0;         // written by the producer
+LOG_STATE uint32_t droppedReported = 0; // written by the consumer
+LOG_STATE LogCallback callback = NULL;
+
+static const char *levelNames[] = {"none", "error", "warn", "info", "debug"};
+
+
+/*
+ * Queue a line, or count it as dropped if the ring is full
+ */
+void logPrintf(uint8_t level, const char *format, ...){
+  LogLine *line = lines.claim();
+  if(!line){
+    dropped++;
+    return;
+  }
+  line->level = level;
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line->text, sizeof(line->text), format, args);
+  va_end(args);
+  lines.publish();
+}
+
+
+/*
+ * Send up to maxLines waiting lines, as many as Serial can take without blocking
+ * Returns the number sent.
+ */
+size_t logProcess(size_t maxLines){
+  size_t sent = 0;
+  LogLine *line;
+  while(sent < maxLines && (line = lines.front()) != NULL){
+    const char *level = logLevelName(line->level);
+    uint32_t lost = dropped - droppedReported;
+    // level, ": ", the line and "\r\n", and the dropped line first if there is one
+    size_t length = strlen(level) + strlen(line->text) + 4 + (lost ? 40 : 0);
+    if((size_t)Serial.availableForWrite() < length){
+      break;
+    }
+    if(lost){
+      droppedReported += lost;
+      Serial.printf("warn: %u log lines dropped\r\n", (unsigned)lost);
+    }
+    Serial.printf("%s: %s\r\n", level, line->text);
+    if(callback){
+      callback(line->level, line->text);
+    }
+    lines.pop();
+    sent++;
+  }
+  return(sent);
+}
+
+
+void logSetCallback(LogCallback logCallback){
+  callback = logCallback;
+}
+
+uint32_t logDropped(){
+  return(dropped);
+}
+
+size_t logPending(){
+  return(lines.size());
+}
+
+const char *logLevelName(uint8_t level){
+  return(level <= LOG_LEVEL_DEBUG ? levelNames[level] : "");
+}
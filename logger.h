@@ -0,0 +1,46 @@
+/*
+ * Log lines, off the control path
+ * LOG_ERROR/LOG_WARN/LOG_INFO/LOG_DEBUG("format", ...) format the line straight into a slot of a lock-free ring
+ * (spscRing.h) and return, they never touch the UART. loop() calls logProcess() last, which sends the waiting
+ * lines to Serial (only as many as the UART can take without blocking) and to the log callback (the websocket
+ * logs topic). If the ring is full the line is dropped and counted, the count is reported with the next line out.
+ *
+ * Levels above LOG_LEVEL are compiled out, arguments and all: build with -DLOG_LEVEL=LOG_LEVEL_DEBUG to get the
+ * debug lines (eg. the PID terms every sample).
+ * Lines are cut at LOG_LINE_LENGTH. Log from the main loop only, not from interrupts (there is one producer).
+ */
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_LINES 16          // power of 2
+#define LOG_LINE_LENGTH 96    // including the terminator, less than the UART FIFO (128)
+#define LOG_DRAIN_LINES 2     // most lines sent per logProcess()
+
+#define LOG_ERROR(...) do { if(LOG_LEVEL >= LOG_LEVEL_ERROR) logPrintf(LOG_LEVEL_ERROR, __VA_ARGS__); } while(0)
+#define LOG_WARN(...) do { if(LOG_LEVEL >= LOG_LEVEL_WARN) logPrintf(LOG_LEVEL_WARN, __VA_ARGS__); } while(0)
+#define LOG_INFO(...) do { if(LOG_LEVEL >= LOG_LEVEL_INFO) logPrintf(LOG_LEVEL_INFO, __VA_ARGS__); } while(0)
+#define LOG_DEBUG(...) do { if(LOG_LEVEL >= LOG_LEVEL_DEBUG) logPrintf(LOG_LEVEL_DEBUG, __VA_ARGS__); } while(0)
+
+typedef void (*LogCallback)(uint8_t level, const char *line);
+
+void logPrintf(uint8_t level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+size_t logProcess(size_t maxLines = LOG_DRAIN_LINES);
+void logSetCallback(LogCallback callback);
+uint32_t logDropped(void);
+size_t logPending(void);
+const char *logLevelName(uint8_t level);
+
+#endif  // LOGGER_H
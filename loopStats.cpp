@@ -0,0 +1,46 @@
+#include "loopStats.h"
+#include "controller.h"
+#include "triacOutput.h"
+
+LoopStats loopStats;
+
+static const char *stageNames[NUM_STAGES] = {"loop", "controller", "http", "websocket", "webserver", "log", "triac_late"};
+
+
+LoopStats::LoopStats(){
+  setSampleInterval(SAMPLE_INTERVAL);
+  stage[STAGE_TRIAC_LATE].setLimit(fromMicros(TRIAC_HALF_CYCLE_US));
+}
+
+
+/*
+ * The loop stages overrun when they take longer than this [ms]
+ */
+void LoopStats::setSampleInterval(unsigned long sampleInterval){
+  for(uint8_t s=0; s<NUM_STAGES; s++){
+    if(s != STAGE_TRIAC_LATE){
+      stage[s].setLimit(fromMicros(sampleInterval*1000));
+    }
+  }
+}
+
+
+void LoopStats::clear(){
+  for(uint8_t s=0; s<NUM_STAGES; s++){
+    stage[s].clear();
+  }
+}
+
+
+const char *LoopStats::name(LoopStage s){
+  return(s < NUM_STAGES ? stageNames[s] : "");
+}
+
+uint32_t LoopStats::toMicros(uint32_t cycles){
+  return(cycles/ESP.getCpuFreqMHz());
+}
+
+uint32_t LoopStats::fromMicros(uint32_t us){
+  uint64_t cycles = (uint64_t)us*ESP.getCpuFreqMHz();
+  return(cycles > UINT32_MAX ? UINT32_MAX : cycles);
+}
@@ -0,0 +1,61 @@
+/*
+ * Main loop instrumentation
+ * A latency histogram (see latencyHistogram.h) for each stage of loop(), timed with the CPU cycle counter,
+ * and one for how late the polled triac output runs after each of its period/half cycle boundaries.
+ * A loop stage overruns when it takes longer than the controller's sample interval (it would have made the
+ * controller miss a sample), the triac runs late if it is more than a mains half cycle late (a half cycle
+ * went by with the wrong output).
+ *
+ * In the scheduler's tasks (CoffeeRoaster.ino):
+ *   StageTimer timer;
+ *   controller.process();
+ *   timer.lap(STAGE_CONTROLLER);
+ * and timer.end() around the whole of loop(), which costs a couple of cycle counter reads and a histogram add
+ * per stage.
+ */
+#ifndef LOOPSTATS_H
+#define LOOPSTATS_H
+
+#include <Arduino.h>
+#include "latencyHistogram.h"
+
+enum LoopStage {STAGE_LOOP, STAGE_CONTROLLER, STAGE_HTTP, STAGE_WEBSOCKET, STAGE_WEBSERVER, STAGE_LOG, STAGE_TRIAC_LATE, NUM_STAGES};
+
+class LoopStats {
+ public:
+  LatencyHistogram stage[NUM_STAGES];
+
+  LoopStats();
+  void setSampleInterval(unsigned long sampleInterval);
+  void clear();
+
+  static const char *name(LoopStage stage);
+  static uint32_t toMicros(uint32_t cycles);
+  static uint32_t fromMicros(uint32_t us);
+};
+
+extern LoopStats loopStats;
+
+
+class StageTimer {
+ public:
+  StageTimer() : _start(ESP.getCycleCount()), _lap(_start) {}
+
+  // the time since the last lap (or the start) goes to stage
+  void lap(LoopStage stage){
+    uint32_t now = ESP.getCycleCount();
+    loopStats.stage[stage].add(now - _lap);
+    _lap = now;
+  }
+
+  // the time since the start goes to STAGE_LOOP
+  void end(){
+    loopStats.stage[STAGE_LOOP].add(ESP.getCycleCount() - _start);
+  }
+
+ private:
+  uint32_t _start;
+  uint32_t _lap;
+};
+
+#endif  // LOOPSTATS_H
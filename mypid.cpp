@@ -1,46 +1,86 @@
 #include "mypid.h"
 #include <Arduino.h>
+#include "logger.h"
 
 
-PID::PID(double Kp, double Ki, double Kd){
+// A time interval in us as seconds. Done in integer maths for fixed point.
+static void secondsFromMicros(unsigned long us, double *seconds){
+  *seconds = us/1000000.0;
+}
+
+static void secondsFromMicros(unsigned long us, float *seconds){
+  *seconds = us/1000000.0f;
+}
+
+template <int FRAC_BITS>
+static void secondsFromMicros(unsigned long us, Fixed<FRAC_BITS> *seconds){
+  *seconds = Fixed<FRAC_BITS>::fromRaw((int32_t)(((int64_t)us << FRAC_BITS)/1000000));
+}
+
+
+template <typename T>
+BasicPID<T>::BasicPID(double Kp, double Ki, double Kd){
   _derivative_of_input = true;
   _mode = 0;
-  _setpoint = 0;
+  _setpoint = T(0);
+  _numBands = 1;
+  _band = 0;
+  for(uint8_t b=0; b<PID_MAX_BANDS; b++){
+    _bands[b].temperature = T(0);
+  }
   setTunings(Kp, Ki, Kd);
   reset();
-  _outputMin = 0;
-  _outputMax = 100;
+  _outputMin = T(0);
+  _outputMax = T(100);
 }
 
 
-double PID::compute(double input){
+template <typename T>
+double BasicPID<T>::compute(double input_in){
   //How long since we last calculated
-  unsigned long now = millis();
-  unsigned long timeChange = (double)((now - _lastTime)/1000.0);
+  //32 bit unsigned subtraction, so it is still right across a micros() roll over
+  uint32_t now = micros();
+  uint32_t timeChange = now - _lastTime;
 
   // Calculate the error term
-  double error = _setpoint - input;
+  T input = T(input_in);
+  T error = _setpoint - input;
+  if(_numBands > 1){
+    schedule(error);
+  }
 
   //special case for the first datapoint
-  if(_lastTime == 0){
+  if(!_running){
     double output = 0;
     _lastErr = error;
     _lastInput = input;
     _lastTime = now;
+    _running = true;
     return(output);
   }
 
   //Compute all the other error variables
-  _iTerm += _Ki*(error*timeChange);
-  double dInput = (input - _lastInput) / timeChange;
-  double dErr = (error - _lastErr) / timeChange;
+  T dt;
+  secondsFromMicros(timeChange, &dt);
+  _iTerm += _Ki*(error*dt);
+  T dInput = input - _lastInput;
+  T dErr = error - _lastErr;
 
   //Compute PID Output
-  double output = 0;
+  //Only the derivative we are using is divided by the time change
+  T output;
   if(_derivative_of_input){
-    output = _Kp*error + _iTerm - _Kd*dInput;
+    output = _Kp*error + _iTerm;
+    if(dt > T(0)){
+      dInput = dInput / dt;
+      output -= _Kd*dInput;
+    }
   }else{
-    output = _Kp*error + _iTerm + _Kd*dErr;
+    output = _Kp*error + _iTerm;
+    if(dt > T(0)){
+      dErr = dErr / dt;
+      output += _Kd*dErr;
+    }
   }
 
   //Check if we are inside the limits
@@ -52,87 +92,207 @@ double PID::compute(double input){
     _iTerm += _outputMin - output;
     output = _outputMin;
   }
-  
+
   //Remember some variables for next time
   _lastErr = error;
   _lastInput = input;
   _lastTime = now;
 
-  Serial.print("error="); Serial.println(error); 
-  Serial.print("kp="); Serial.println(_Kp);
-  Serial.print("Iterm=");Serial.println(_iTerm);
-  Serial.print("dInput=");Serial.print(dInput);
-  Serial.print("dErr=");Serial.print(dErr);
-  Serial.print("output="); Serial.println(output); 
-  Serial.println("");
+  LOG_DEBUG("pid error=%.2f kp=%.3f iterm=%.2f dInput=%.2f dErr=%.2f output=%.2f",
+            (double)error, (double)_Kp, (double)_iTerm, (double)dInput, (double)dErr, (double)output);
 
-  return(output);
+  return((double)output);
 }
 
 
-void PID::setTunings(double Kp, double Ki, double Kd){
+template <typename T>
+void BasicPID<T>::setTunings(double Kp, double Ki, double Kd){
   setP(Kp);
   setI(Ki);
   setD(Kd);
 }
 
-void PID::setP(double Kp){
-  if(Kp < 0){
-    _Kp = 0;
-  }else{
-    _Kp = Kp;
+// gains can't be negative
+template <typename T>
+static T gain(double K){
+  return(K < 0 ? T(0) : T(K));
+}
+
+template <typename T>
+void BasicPID<T>::setP(double Kp){
+  _Kp = gain<T>(Kp);
+  for(uint8_t b=0; b<PID_MAX_BANDS; b++){
+    _bands[b].Kp = _Kp;
   }
 }
 
-void PID::setI(double Ki){
+template <typename T>
+void BasicPID<T>::setI(double Ki){
   if(Ki <= 0){
     // If we set ki to zero, then reset the integral term to zero.
     // This could cause a step change in the output though.
-    _iTerm = 0;
-    _Ki = 0;
-  }else{
-    _Ki = Ki;
+    _iTerm = T(0);
+  }
+  _Ki = gain<T>(Ki);
+  for(uint8_t b=0; b<PID_MAX_BANDS; b++){
+    _bands[b].Ki = _Ki;
   }
 }
 
-void PID::setD(double Kd){
-  if(Kd < 0){
-    _Kd = 0;
-  }else{
-    _Kd = Kd;
+template <typename T>
+void BasicPID<T>::setD(double Kd){
+  _Kd = gain<T>(Kd);
+  for(uint8_t b=0; b<PID_MAX_BANDS; b++){
+    _bands[b].Kd = _Kd;
+  }
+}
+
+template <typename T>
+double BasicPID<T>::getP(){
+  return((double)_Kp);
+}
+template <typename T>
+double BasicPID<T>::getI(){
+  return((double)_Ki);
+}
+template <typename T>
+double BasicPID<T>::getD(){
+  return((double)_Kd);
+}
+
+/*
+ * The gains for one band of the schedule, they take effect at the next compute()
+ */
+template <typename T>
+void BasicPID<T>::setP(double Kp, uint8_t band){
+  if(band < PID_MAX_BANDS){
+    _bands[band].Kp = gain<T>(Kp);
+  }
+}
+
+template <typename T>
+void BasicPID<T>::setI(double Ki, uint8_t band){
+  if(band < PID_MAX_BANDS){
+    _bands[band].Ki = gain<T>(Ki);
+  }
+}
+
+template <typename T>
+void BasicPID<T>::setD(double Kd, uint8_t band){
+  if(band < PID_MAX_BANDS){
+    _bands[band].Kd = gain<T>(Kd);
+  }
+}
+
+template <typename T>
+double BasicPID<T>::getP(uint8_t band){
+  return(band < PID_MAX_BANDS ? (double)_bands[band].Kp : 0);
+}
+template <typename T>
+double BasicPID<T>::getI(uint8_t band){
+  return(band < PID_MAX_BANDS ? (double)_bands[band].Ki : 0);
+}
+template <typename T>
+double BasicPID<T>::getD(uint8_t band){
+  return(band < PID_MAX_BANDS ? (double)_bands[band].Kd : 0);
+}
+
+/*
+ * How many bands of the schedule are in use, 1 for fixed gains
+ */
+template <typename T>
+void BasicPID<T>::setBands(uint8_t bands){
+  _numBands = bands < 1 ? 1 : (bands > PID_MAX_BANDS ? PID_MAX_BANDS : bands);
+  _band = 0;
+  if(_numBands == 1){
+    _Kp = _bands[0].Kp;
+    _Ki = _bands[0].Ki;
+    _Kd = _bands[0].Kd;
   }
 }
 
-double PID::getP(){
-  return(_Kp);
+template <typename T>
+uint8_t BasicPID<T>::getBands(){
+  return(_numBands);
 }
-double PID::getI(){
-  return(_Ki);
+
+template <typename T>
+void BasicPID<T>::setBandTemperature(uint8_t band, double temperature){
+  if(band < PID_MAX_BANDS){
+    _bands[band].temperature = T(temperature);
+  }
+}
+
+template <typename T>
+double BasicPID<T>::getBandTemperature(uint8_t band){
+  return(band < PID_MAX_BANDS ? (double)_bands[band].temperature : 0);
 }
-double PID::getD(){
-  return(_Kd);
+
+/*
+ * Move the gains in effect to the schedule's at the setpoint
+ * The setpoint moves slowly, so the band is found by stepping from the one it was in last time.
+ */
+template <typename T>
+void BasicPID<T>::schedule(T error){
+  T x = _setpoint;
+  while(_band + 1 < _numBands && x >= _bands[_band + 1].temperature){
+    _band++;
+  }
+  while(_band > 0 && x < _bands[_band].temperature){
+    _band--;
+  }
+
+  const Band &lo = _bands[_band];
+  T Kp = lo.Kp, Ki = lo.Ki, Kd = lo.Kd;
+  if(_band + 1 < _numBands && x > lo.temperature){
+    // between this band and the next, which is above x (so this never divides by zero)
+    const Band &hi = _bands[_band + 1];
+    T f = (x - lo.temperature)/(hi.temperature - lo.temperature);
+    Kp = lo.Kp + (hi.Kp - lo.Kp)*f;
+    Ki = lo.Ki + (hi.Ki - lo.Ki)*f;
+    Kd = lo.Kd + (hi.Kd - lo.Kd)*f;
+  }
+
+  // bumpless: the integral term takes up the change in Kp*error
+  // (it is already the sum of ki*error*dt, so a change of Ki doesn't move the output)
+  // a change of Kd isn't taken up, see mypid.h
+  if(_running){
+    _iTerm += (_Kp - Kp)*error;
+  }
+  _Kp = Kp;
+  _Ki = Ki;
+  _Kd = Kd;
 }
 
-void PID::setSetpoint(double setpoint){
-  _setpoint = setpoint;
+template <typename T>
+void BasicPID<T>::setSetpoint(double setpoint){
+  _setpoint = T(setpoint);
 }
 
-double PID::getSetpoint(void){
-  return(_setpoint);
+template <typename T>
+double BasicPID<T>::getSetpoint(void){
+  return((double)_setpoint);
 }
 
-void PID::setOutputLimits(double outputMin, double outputMax){
+template <typename T>
+void BasicPID<T>::setOutputLimits(double outputMin, double outputMax){
   if(outputMin > outputMax){
     return;
   }
-  _outputMax = outputMax;
-  _outputMin = outputMin;
+  _outputMax = T(outputMax);
+  _outputMin = T(outputMin);
 }
 
-void PID::reset(){
-  _iTerm = 0;
-  _lastErr = 0;
-  _lastInput = 0;
+template <typename T>
+void BasicPID<T>::reset(){
+  _iTerm = T(0);
+  _lastErr = T(0);
+  _lastInput = T(0);
   _lastTime = 0;
+  _running = false;
 }
 
+
+template class BasicPID<double>;
+template class BasicPID<float>;
+template class BasicPID<Q16_16>;
@@ -1,25 +1,51 @@
 /*
  * PID controller
- * Eventually needs to be wrapped up into a class
  * set the setpoints and tune the pid parameters and limits.
- * Then call PIDCompute to calcualte the output.
+ * Then call compute to calcualte the output.
  * Doesn't need to be called at a regular interval - it keeps track of the interval between calls.
- * 
+ * The interval is measured with micros(), so it can run well under a second between calls (and copes with micros() rolling over).
+ *
  * Save Iterm = ki*(error*timeChange) instead of just error. then if ki changes we don't have to modify the sum term
  * http://brettbeauregard.com/blog/2011/04/improving-the-beginner%E2%80%99s-pid-tuning-changes/
- * 
+ *
  * Default to calculating derivative of input. Able to switch to derivative of error by setting _derivative_of_input to false
  * dInput should eliminate "derivative kick" - http://brettbeauregard.com/blog/2011/04/improving-the-beginner%E2%80%99s-pid-derivative-kick/
+ *
+ * Gain scheduling: up to PID_MAX_BANDS bands, each a setpoint temperature and the gains to use there.
+ * Between two band temperatures the gains are interpolated linearly, outside them the nearest band's are used.
+ * It is scheduled on the setpoint rather than the measured temperature, so noise doesn't move the gains.
+ * When the gains change the integral term takes up the change in the proportional term, so that doesn't make
+ * the output jump (bumpless). The derivative term isn't bumpless: a change of Kd steps the output by the change
+ * times the current derivative. Taking that up too would put the derivative's noise into the integral term for
+ * good, and the gains only move a little at a time as the setpoint moves. With one band (the default) the gains
+ * are fixed, as before.
+ * setP(Kp)/setI(Ki)/setD(Kd) set every band, setP(Kp, band) etc. just that one. getP() is the gain in effect now.
+ * Band temperatures have to go up with the band number.
+ *
+ * The maths is done in the numeric type T. The interface is always double.
+ *  - BasicPID<double>: for the host analysis tools
+ *  - BasicPID<Q16_16>: fixed point (fixedPoint.h), for the ESP8266 which has no FPU
+ * PID is whichever one PID_NUMERIC_TYPE selects (fixed point on the ESP8266, double anywhere else).
+ * The implementation is in mypid.cpp, explicitly instantiated for double, float and Q16_16.
  */
 
 #ifndef MYPID_H
 #define MYPID_H
 
-class PID {
-  
+#include "fixedPoint.h"
+
+#define PID_MAX_BANDS 4
+// The largest gain worth setting. Kp*error stays inside Q16.16 (+/-32768) for errors up to 300 oC (the most the
+// setpoint can be), so the fixed point PID gives the same output as the double one. Above it the fixed point
+// terms saturate: still full on for a big error, but no longer the same as double.
+#define PID_MAX_GAIN 100
+
+template <typename T>
+class BasicPID {
+
  public:
 
-  PID(double Kp, double Ki, double Kd);
+  BasicPID(double Kp, double Ki, double Kd);
   void setTunings(double Kp, double Ki, double Kd);
   void setP(double Kp);
   void setI(double Ki);
@@ -27,6 +53,16 @@ class PID {
   double getP();
   double getI();
   double getD();
+  void setP(double Kp, uint8_t band);
+  void setI(double Ki, uint8_t band);
+  void setD(double Kd, uint8_t band);
+  double getP(uint8_t band);
+  double getI(uint8_t band);
+  double getD(uint8_t band);
+  void setBands(uint8_t bands);
+  uint8_t getBands();
+  void setBandTemperature(uint8_t band, double temperature);
+  double getBandTemperature(uint8_t band);
   void reset();
   void setSetpoint(double setpoint);
   double getSetpoint();
@@ -34,17 +70,38 @@ class PID {
   void setOutputLimits(double _outputMin, double _outputMax);
 
  private:
+  struct Band {
+    T temperature;
+    T Kp, Ki, Kd;
+  };
+
+  void schedule(T error);
+
   //set variables
-  double _Kp, _Ki, _Kd;
-  double _outputMin, _outputMax;
-  double _setpoint;
+  T _Kp, _Ki, _Kd;           // in effect now
+  Band _bands[PID_MAX_BANDS];
+  uint8_t _numBands;
+  uint8_t _band;             // the band the setpoint was in last time
+  T _outputMin, _outputMax;
+  T _setpoint;
   unsigned char _mode;
   bool _derivative_of_input;
 
   // internal variables
-  unsigned long _lastTime;
-  double _iTerm;
-  double _lastErr, _lastInput; 
+  bool _running;            // false until the first compute after a reset
+  uint32_t _lastTime;       // [us]
+  T _iTerm;
+  T _lastErr, _lastInput;
 };
 
+#ifndef PID_NUMERIC_TYPE
+#ifdef ARDUINO_ARCH_ESP8266
+#define PID_NUMERIC_TYPE Q16_16
+#else
+#define PID_NUMERIC_TYPE double
+#endif
+#endif
+
+typedef BasicPID<PID_NUMERIC_TYPE> PID;
+
 #endif  // MYPID_H
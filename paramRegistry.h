@@ -0,0 +1,104 @@
+/*
+ * Parameter registry
+ * A parameter is one row in a constexpr table of ParamDef: its name, type, getter/setter, limits and flags.
+ * Everything that deals with parameters by name (the websocket status and setters, the saved config) works
+ * from the table, so adding a parameter is adding a row.
+ *
+ * Names are looked up with a perfect hash worked out at compile time: a seed is searched for which puts every
+ * name in the table in a different slot of a power of 2 sized slot table, and the slot table is built from it.
+ * A lookup is then one hash of the name, one slot and one strcmp() to reject names which aren't in the table.
+ * No allocation, and it is a compile error if no seed is found (make the slot table bigger).
+ *
+ * Written for C++11 constexpr (one return statement, so recursion instead of loops) for the ESP8266 compiler.
+ */
+#ifndef PARAMREGISTRY_H
+#define PARAMREGISTRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum ParamType {PARAM_DOUBLE, PARAM_INT};
+
+// flags
+#define PARAM_WRITABLE 1  // can be set from the websocket
+#define PARAM_STATUS 2    // sent in the status
+#define PARAM_PERSIST 4   // saved in the config file
+#define PARAM_LIVE 8      // sent in the datapoints while the PID is running, so left out of the status then
+#define PARAM_DIAGNOSTIC 16  // sent in the diagnostics
+
+typedef double (*ParamGetter)(void);
+typedef void (*ParamSetter)(double value);
+
+struct ParamDef {
+  const char *name;
+  ParamType type;
+  ParamGetter get;
+  ParamSetter set;        // NULL if read only
+  double min, max;        // values set are clamped to these
+  uint8_t flags;
+  double resolution;      // smallest change worth sending in the status (0 = any change)
+};
+
+
+// FNV-1a, starting from the seed
+constexpr uint32_t paramHash(const char *name, uint32_t hash){
+  return(*name ? paramHash(name + 1, (hash ^ (uint8_t)*name)*16777619u) : hash ^ (hash >> 15));
+}
+
+// slots is a power of 2
+constexpr uint32_t paramSlot(const char *name, uint32_t seed, size_t slots){
+  return(paramHash(name, seed) & (slots - 1));
+}
+
+// true if defs[i] is in a different slot from all of defs[j..n)
+constexpr bool paramSlotFree(const ParamDef *defs, size_t n, uint32_t seed, size_t slots, size_t i, size_t j){
+  return(j >= n || (paramSlot(defs[i].name, seed, slots) != paramSlot(defs[j].name, seed, slots) && paramSlotFree(defs, n, seed, slots, i, j + 1)));
+}
+
+// true if every one of defs[i..n) has its own slot
+constexpr bool paramPerfect(const ParamDef *defs, size_t n, uint32_t seed, size_t slots, size_t i = 0){
+  return(i >= n || (paramSlotFree(defs, n, seed, slots, i, i + 1) && paramPerfect(defs, n, seed, slots, i + 1)));
+}
+
+constexpr uint32_t paramSearch(const ParamDef *defs, size_t n, size_t slots, uint32_t seed, uint32_t count);
+
+// found in the first half of [seed, seed + count) if it isn't the end of it, otherwise search the second half
+constexpr uint32_t paramSearchSecond(const ParamDef *defs, size_t n, size_t slots, uint32_t seed, uint32_t count, uint32_t found){
+  return(found != seed + count/2 ? found : paramSearch(defs, n, slots, seed + count/2, count - count/2));
+}
+
+// the first seed in [seed, seed + count) which is perfect for defs, seed + count if there isn't one
+// split in halves so the recursion is only log2(count) deep however many seeds are tried
+constexpr uint32_t paramSearch(const ParamDef *defs, size_t n, size_t slots, uint32_t seed, uint32_t count){
+  return(count == 1 ? (paramPerfect(defs, n, seed, slots) ? seed : seed + 1)
+                    : paramSearchSecond(defs, n, slots, seed, count, paramSearch(defs, n, slots, seed, count/2)));
+}
+
+// the first seed from seed on which is perfect for defs (check it with paramPerfect(), there might not be one)
+constexpr uint32_t paramFindSeed(const ParamDef *defs, size_t n, size_t slots, uint32_t seed = 2166136261u){
+  return(paramSearch(defs, n, slots, seed, 1UL << 16));
+}
+
+// the index of the one in slot, -1 if the slot is empty
+constexpr int8_t paramInSlot(const ParamDef *defs, size_t n, uint32_t seed, size_t slots, size_t slot, size_t i = 0){
+  return(i >= n ? -1 : (paramSlot(defs[i].name, seed, slots) == slot ? (int8_t)i : paramInSlot(defs, n, seed, slots, slot, i + 1)));
+}
+
+
+template<size_t SLOTS> struct ParamSlots {
+  int8_t index[SLOTS];
+};
+
+// 0..N-1 as a parameter pack, to build the slot table with
+template<size_t... I> struct ParamIndices {};
+template<size_t N, size_t... I> struct MakeParamIndices : MakeParamIndices<N - 1, N - 1, I...> {};
+template<size_t... I> struct MakeParamIndices<0, I...> {
+  typedef ParamIndices<I...> type;
+};
+
+template<size_t... I>
+constexpr ParamSlots<sizeof...(I)> makeParamSlots(const ParamDef *defs, size_t n, uint32_t seed, ParamIndices<I...>){
+  return(ParamSlots<sizeof...(I)>{{paramInSlot(defs, n, seed, sizeof...(I), I)...}});
+}
+
+#endif  // PARAMREGISTRY_H
@@ -0,0 +1,95 @@
+#include "paramStore.h"
+#include <math.h>
+
+
+ParamStore::ParamStore(const ParamDef *defs, uint8_t count) : _defs(defs) {
+  _count = count > PARAM_MAX ? PARAM_MAX : count;
+  // nothing has a value yet, so the first set() of each one is a change
+  _held = 0;
+  for(uint8_t i=0; i<PARAM_MAX; i++){
+    _values[i] = NAN;
+    _epochs[i] = 0;
+  }
+  _epoch = 0;
+  _dirty = 0;
+}
+
+
+/*
+ * Update a parameter, returns true if that was a change (and it is now dirty)
+ */
+bool ParamStore::set(uint8_t param, double value){
+  if(param >= _count){
+    return(false);
+  }
+  if(_held & (1UL << param)){
+    double old = _values[param];
+    if(isnan(old) || isnan(value)){
+      // NaN is a value here (eg. no temperature), only going to or from it is a change
+      if(isnan(old) && isnan(value)){
+        return(false);
+      }
+    }else{
+      // within the resolution keeps the old value, so slow drift still adds up to a change
+      double diff = fabs(value - old);
+      if(diff == 0 || diff < _defs[param].resolution){
+        return(false);
+      }
+    }
+  }
+  _values[param] = value;
+  _held |= 1UL << param;
+  _epochs[param] = ++_epoch;
+  _dirty |= 1UL << param;
+  return(true);
+}
+
+
+double ParamStore::get(uint8_t param){
+  return(param < _count ? _values[param] : NAN);
+}
+
+
+const char *ParamStore::name(uint8_t param){
+  return(param < _count ? _defs[param].name : "");
+}
+
+uint8_t ParamStore::count(){
+  return(_count);
+}
+
+uint32_t ParamStore::epoch(){
+  return(_epoch);
+}
+
+
+/*
+ * Bitmask of the parameters which changed after epoch
+ */
+uint32_t ParamStore::changedSince(uint32_t epoch){
+  uint32_t mask = 0;
+  for(uint8_t i=0; i<_count; i++){
+    // unsigned difference, so it is right when the epoch wraps
+    if(_epochs[i] - epoch - 1 < _epoch - epoch){
+      mask |= 1UL << i;
+    }
+  }
+  return(mask);
+}
+
+
+uint32_t ParamStore::dirty(){
+  return(_dirty);
+}
+
+void ParamStore::clearDirty(){
+  _dirty = 0;
+}
+
+
+/*
+ * Bitmask of every parameter which has a value
+ */
+uint32_t ParamStore::all(){
+  return(_held);
+}
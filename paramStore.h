@@ -0,0 +1,45 @@
+/*
+ * Status parameter store with change tracking
+ * Holds the last value sent to the browser for each status parameter, so the web layer only sends what changed.
+ *
+ * Parameters are numbered as in the registry (see paramRegistry.h, at most PARAM_MAX of them). A new value only
+ * counts as a change if it differs from the held one by at least the parameter's resolution (0 = any change),
+ * so a noisy temperature doesn't go out on every reading.
+ * Every change bumps the store's epoch and records it against the parameter. Parameters changed since some
+ * epoch come back as a bitmask (bit n = parameter n), so each client can be brought up to date from the epoch
+ * it was last sent. The dirty mask is everything changed since the last clearDirty().
+ */
+#ifndef PARAMSTORE_H
+#define PARAMSTORE_H
+
+#include <stdint.h>
+#include "paramRegistry.h"
+
+#define PARAM_MAX 32
+
+class ParamStore {
+ public:
+  ParamStore(const ParamDef *defs, uint8_t count);
+
+  bool set(uint8_t param, double value);
+  double get(uint8_t param);
+  const char *name(uint8_t param);
+  uint8_t count();
+
+  uint32_t epoch();
+  uint32_t changedSince(uint32_t epoch);
+  uint32_t dirty();
+  void clearDirty();
+  uint32_t all();
+
+ private:
+  const ParamDef *_defs;
+  uint8_t _count;
+  double _values[PARAM_MAX];
+  uint32_t _epochs[PARAM_MAX];  // when each one last changed
+  uint32_t _held;               // the ones which have been set
+  uint32_t _epoch;
+  uint32_t _dirty;
+};
+
+#endif  // PARAMSTORE_H
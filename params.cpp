@@ -0,0 +1,166 @@
+#include "params.h"
+#include <string.h>
+#include <math.h>
+#include "controller.h"
+#include "webServer.h"
+#include "samplePublisher.h"
+#include "loopStats.h"
+#include "logger.h"
+#include "controllerEvents.h"
+#include "roastHistory.h"
+
+#define PARAM_SLOTS 128  // power of 2, a few times the number of parameters so a seed is quick to find
+
+
+static double getP(){ return(controller.getP()); }
+static void setP(double value){ controller.setP(value); }
+static double getI(){ return(controller.getI()); }
+static void setI(double value){ controller.setI(value); }
+static double getD(){ return(controller.getD()); }
+static void setD(double value){ controller.setD(value); }
+static double getGainBands(){ return(controller.myPID.getBands()); }
+static double getSetpoint(){ return(controller.getSetpoint()); }
+static void setSetpoint(double value){ controller.setSetpoint(value); }
+static double getRampRate(){ return(controller.ramp_rate); }
+static void setRampRate(double value){ controller.ramp_rate = value; }
+static double getTemperature(){ return(controller.getTemperature()); }
+static double getEstimatedTemperature(){
+  return(controller.getEstimatorMode() == ESTIMATOR_KALMAN ? controller.estimator.getTemperature() : NAN);
+}
+static double getProgramMode(){ return(controller.programMode); }
+static double getState(){ return(controller.state); }
+static double getProgramSegment(){ return(controller.profile.currentSegment()); }
+static double getDutyCycle(){ return(controller.triac.getDutyCycle()); }
+static double getTriacMode(){ return(controller.triac.getDistribution()); }
+static void setTriacMode(double value){
+  // 0 = burst, 1 = sigma-delta
+  controller.triac.setDistribution(value == TRIAC_SIGMA_DELTA ? TRIAC_SIGMA_DELTA : TRIAC_BURST);
+}
+static double getSampleInterval(){ return(controller.getSampleInterval()); }
+static void setSampleInterval(double value){
+  controller.setSampleInterval(value);
+  loopStats.setSampleInterval(controller.getSampleInterval());
+}
+// how far back the history goes at this sample interval [s]
+static double getHistorySpan(){ return(HISTORY_CAPACITY*(controller.getSampleInterval()/1000.0)); }
+static double getThermocoupleFault(){ return(controller.thermocouple.getFault()); }
+static double getEstimator(){ return(controller.getEstimatorMode()); }
+static void setEstimator(double value){
+  // 0 = control on the measured temperature, 1 = on the Kalman estimate of the bean temperature
+  controller.setEstimatorMode(value == ESTIMATOR_KALMAN ? ESTIMATOR_KALMAN : ESTIMATOR_OFF);
+}
+static double getPublishInterval(){ return(webserverGetPublishInterval()); }
+static void setPublishInterval(double value){ webserverSetPublishInterval(value); }
+static double getPublishBatch(){ return(webserverGetPublishBatch()); }
+static void setPublishBatch(double value){ webserverSetPublishBatch(value); }
+static double getWsDropped(){ return(webserverFanOut().getDropped()); }
+static double getWsCoalesced(){ return(webserverFanOut().getCoalesced()); }
+static double getWsDisconnects(){ return(webserverFanOut().getDisconnects()); }
+static double getWsMessages(){ return(webserverFanOut().getMessages()); }
+static double getWsBytes(){ return(webserverFanOut().getBytes()); }
+static double getWsPeakQueued(){ return(webserverFanOut().getPeakQueued()); }
+static double getTemperatureAge(){ return(controller.thermocouple.getAge()); }
+static double getThermocoupleFaults(){ return(controller.thermocouple.getFaultCount()); }
+static double getUptime(){ return(millis()/1000.0); }
+static double getFreeHeap(){ return(ESP.getFreeHeap()); }
+static double getMaxFreeBlock(){ return(ESP.getMaxFreeBlockSize()); }
+static double getLogDropped(){ return(logDropped()); }
+static double getEventsDropped(){ return(controllerEventsDropped()); }
+
+
+static constexpr ParamDef params[] = {
+  // name                    type          getter                   setter              min                  max                 flags                                       resolution
+  {"p",                      PARAM_DOUBLE, getP,                    setP,               0,                   PID_MAX_GAIN,       PARAM_WRITABLE | PARAM_STATUS | PARAM_PERSIST, 0},
+  {"i",                      PARAM_DOUBLE, getI,                    setI,               0,                   PID_MAX_GAIN,       PARAM_WRITABLE | PARAM_STATUS | PARAM_PERSIST, 0},
+  {"d",                      PARAM_DOUBLE, getD,                    setD,               0,                   PID_MAX_GAIN,       PARAM_WRITABLE | PARAM_STATUS | PARAM_PERSIST, 0},
+  {"gain_bands",             PARAM_INT,    getGainBands,            NULL,               0,                   0,                  PARAM_STATUS,                                  0},
+  {"setpoint",               PARAM_DOUBLE, getSetpoint,             setSetpoint,        0,                   300,                PARAM_WRITABLE | PARAM_STATUS,                 0},
+  {"ramp_rate",              PARAM_DOUBLE, getRampRate,             setRampRate,        0,                   1000,               PARAM_WRITABLE | PARAM_STATUS,                 0},
+  {"temperature",            PARAM_DOUBLE, getTemperature,          NULL,               0,                   0,                  PARAM_STATUS | PARAM_LIVE,                     0.25},
+  {"estimated_temperature",  PARAM_DOUBLE, getEstimatedTemperature, NULL,               0,                   0,                  PARAM_STATUS | PARAM_LIVE,                     0.25},
+  {"programMode",            PARAM_INT,    getProgramMode,          NULL,               0,                   0,                  PARAM_STATUS,                                  0},
+  {"state",                  PARAM_INT,    getState,                NULL,               0,                   0,                  PARAM_STATUS,                                  0},
+  {"program_segment",        PARAM_INT,    getProgramSegment,       NULL,               0,                   0,                  PARAM_STATUS,                                  0},
+  {"duty_cycle",             PARAM_DOUBLE, getDutyCycle,            NULL,               0,                   0,                  PARAM_STATUS | PARAM_LIVE,                     0.1},
+  {"triac_mode",             PARAM_INT,    getTriacMode,            setTriacMode,       0,                   1,                  PARAM_WRITABLE | PARAM_STATUS | PARAM_PERSIST, 0},
+  {"sample_interval",        PARAM_DOUBLE, getSampleInterval,       setSampleInterval,  MIN_SAMPLE_INTERVAL, 60000,              PARAM_WRITABLE | PARAM_STATUS | PARAM_PERSIST, 0},
+  {"history_span",           PARAM_DOUBLE, getHistorySpan,          NULL,               0,                   0,                  PARAM_STATUS,                                  0},
+  {"thermocouple_fault",     PARAM_INT,    getThermocoupleFault,    NULL,               0,                   0,                  PARAM_STATUS,                                  0},
+  {"estimator",              PARAM_INT,    getEstimator,            setEstimator,       0,                   1,                  PARAM_WRITABLE | PARAM_STATUS | PARAM_PERSIST, 0},
+  {"publish_interval",       PARAM_INT,    getPublishInterval,      setPublishInterval, 0,                   60000,              PARAM_WRITABLE | PARAM_STATUS,                 0},
+  {"publish_batch",          PARAM_INT,    getPublishBatch,         setPublishBatch,    1,                   PUBLISH_CAPACITY,   PARAM_WRITABLE | PARAM_STATUS,                 0},
+  // diagnostics, not in the status (a backed up client would make the websocket ones change all the time)
+  {"ws_messages",            PARAM_INT,    getWsMessages,           NULL,               0,                   0,                  PARAM_DIAGNOSTIC,                              0},
+  {"ws_bytes",               PARAM_INT,    getWsBytes,              NULL,               0,                   0,                  PARAM_DIAGNOSTIC,                              0},
+  {"ws_dropped",             PARAM_INT,    getWsDropped,            NULL,               0,                   0,                  PARAM_DIAGNOSTIC,                              0},
+  {"ws_coalesced",           PARAM_INT,    getWsCoalesced,          NULL,               0,                   0,                  PARAM_DIAGNOSTIC,                              0},
+  {"ws_disconnects",         PARAM_INT,    getWsDisconnects,        NULL,               0,                   0,                  PARAM_DIAGNOSTIC,                              0},
+  {"ws_peak_queued",         PARAM_INT,    getWsPeakQueued,         NULL,               0,                   0,                  PARAM_DIAGNOSTIC,                              0},
+  {"temperature_age",        PARAM_INT,    getTemperatureAge,       NULL,               0,                   0,                  PARAM_DIAGNOSTIC,                              0},
+  {"thermocouple_faults",    PARAM_INT,    getThermocoupleFaults,   NULL,               0,                   0,                  PARAM_DIAGNOSTIC,                              0},
+  {"uptime",                 PARAM_DOUBLE, getUptime,               NULL,               0,                   0,                  PARAM_DIAGNOSTIC,                              0},
+  {"free_heap",              PARAM_INT,    getFreeHeap,             NULL,               0,                   0,                  PARAM_DIAGNOSTIC,                              0},
+  {"max_free_block",         PARAM_INT,    getMaxFreeBlock,         NULL,               0,                   0,                  PARAM_DIAGNOSTIC,                              0},
+  {"log_dropped",            PARAM_INT,    getLogDropped,           NULL,               0,                   0,                  PARAM_DIAGNOSTIC,                              0},
+  {"events_dropped",         PARAM_INT,    getEventsDropped,        NULL,               0,                   0,                  PARAM_DIAGNOSTIC,                              0},
+};
+
+#define NUM_PARAMS (sizeof(params)/sizeof(params[0]))
+
+static_assert(NUM_PARAMS <= 32, "status changes are tracked in a 32 bit mask");
+static_assert(NUM_PARAMS <= 127, "parameter numbers are int8_t");
+
+static constexpr uint32_t paramSeed = paramFindSeed(params, NUM_PARAMS, PARAM_SLOTS);
+static_assert(paramPerfect(params, NUM_PARAMS, paramSeed, PARAM_SLOTS), "no perfect hash seed found, make PARAM_SLOTS bigger");
+static constexpr ParamSlots<PARAM_SLOTS> paramSlots = makeParamSlots(params, NUM_PARAMS, paramSeed, MakeParamIndices<PARAM_SLOTS>::type());
+
+
+uint8_t paramCount(){
+  return(NUM_PARAMS);
+}
+
+const ParamDef *paramDefs(){
+  return(params);
+}
+
+
+/*
+ * The number of the parameter called name, -1 if there isn't one
+ */
+int8_t paramFind(const char *name){
+  int8_t param = paramSlots.index[paramSlot(name, paramSeed, PARAM_SLOTS)];
+  if(param < 0 || strcmp(params[param].name, name) != 0){
+    return(-1);
+  }
+  return(param);
+}
+
+
+double paramGet(uint8_t param){
+  if(param >= NUM_PARAMS){
+    return(NAN);
+  }
+  return(params[param].get());
+}
+
+
+/*
+ * Set a parameter, clamped to its limits (and rounded if it is an int)
+ * Returns false if there is no such parameter or it is read only
+ */
+bool paramSet(uint8_t param, double value){
+  if(param >= NUM_PARAMS || params[param].set == NULL || isnan(value)){
+    return(false);
+  }
+  const ParamDef &def = params[param];
+  if(def.type == PARAM_INT){
+    value = round(value);
+  }
+  if(value < def.min){
+    value = def.min;
+  }else if(value > def.max){
+    value = def.max;
+  }
+  def.set(value);
+  return(true);
+}
@@ -0,0 +1,18 @@
+/*
+ * The roaster's parameters
+ * One table (params.cpp) of everything that can be read or set by name: from the websocket, in the status,
+ * and in the saved config. See paramRegistry.h.
+ * Parameters are numbered by their row in the table.
+ */
+#ifndef PARAMS_H
+#define PARAMS_H
+
+#include "paramRegistry.h"
+
+uint8_t paramCount(void);
+const ParamDef *paramDefs(void);
+int8_t paramFind(const char *name);
+double paramGet(uint8_t param);
+bool paramSet(uint8_t param, double value);
+
+#endif  // PARAMS_H
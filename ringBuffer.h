@@ -0,0 +1,46 @@
+/*
+ * Fixed capacity ring buffer
+ * Holds the last N items pushed. Pushing into a full buffer overwrites the oldest item.
+ * Index 0 is the oldest item, size()-1 the newest. No allocation. The indexing is cheapest when N is a power of 2.
+ * Not safe to use from an interrupt and the main loop at the same time.
+ */
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <stddef.h>
+
+template <typename T, size_t N>
+class RingBuffer {
+ public:
+  RingBuffer() : _head(0), _count(0) {}
+
+  void push(const T &item){
+    _items[_head] = item;
+    _head = (_head + 1) % N;
+    if(_count < N){
+      _count++;
+    }
+  }
+
+  // remove and return the oldest item. Only call when not empty
+  T pop(){
+    size_t tail = (_head + N - _count) % N;
+    _count--;
+    return(_items[tail]);
+  }
+
+  const T &operator[](size_t i) const { return _items[(_head + N - _count + i) % N]; }
+  const T &newest() const { return _items[(_head + N - 1) % N]; }
+  size_t size() const { return _count; }
+  size_t capacity() const { return N; }
+  bool empty() const { return _count == 0; }
+  bool full() const { return _count == N; }
+  void clear() { _head = 0; _count = 0; }
+
+ private:
+  T _items[N];
+  size_t _head;   // where the next item goes
+  size_t _count;
+};
+
+#endif  // RINGBUFFER_H
@@ -0,0 +1,109 @@
+#include "roastHistory.h"
+#include <math.h>
+
+
+// round to the nearest step, clamped to the int16 range (keeping INT16_MIN for "no value")
+static int16_t toTenths(float value){
+  if(isnan(value)){
+    return(HISTORY_NO_TEMPERATURE);
+  }
+  float tenths = value*10;
+  if(tenths >= INT16_MAX){
+    return(INT16_MAX);
+  }else if(tenths <= INT16_MIN + 1){
+    return(INT16_MIN + 1);
+  }
+  return((int16_t)lroundf(tenths));
+}
+
+
+static void toPoint(const HistoryRecord &record, DatapointFrame *point){
+  point->timestamp = record.timestamp;
+  point->setpoint = record.setpoint/10.0f;
+  point->temperature = record.temperature == HISTORY_NO_TEMPERATURE ? NAN : record.temperature/10.0f;
+  point->output = record.output/100.0f;
+}
+
+
+RoastHistory::RoastHistory(){
+  _nextSeq = 0;
+  _lastTimestamp = 0;
+}
+
+
+/*
+ * Add a datapoint, returns its sequence number
+ */
+uint32_t RoastHistory::add(const DatapointFrame &point){
+  if(point.timestamp < _lastTimestamp){
+    clear();
+  }
+  _lastTimestamp = point.timestamp;
+
+  HistoryRecord record;
+  record.timestamp = point.timestamp;
+  record.setpoint = toTenths(point.setpoint);
+  record.temperature = toTenths(point.temperature);
+  float output = point.output*100;
+  record.output = output <= 0 ? 0 : (output >= UINT16_MAX ? UINT16_MAX : (uint16_t)lroundf(output));
+  record.reserved = 0;
+  _records.push(record);
+  return(_nextSeq++);
+}
+
+
+/*
+ * Forget the current roast. The sequence numbers carry on from where they were.
+ */
+void RoastHistory::clear(){
+  _records.clear();
+  _lastTimestamp = 0;
+}
+
+
+/*
+ * Read up to max datapoints starting from *seq
+ * If *seq has already been dropped it starts from the oldest one still held, and *seq is updated to say so.
+ * Returns the number read (0 when there is nothing at or after *seq)
+ */
+size_t RoastHistory::read(uint32_t *seq, DatapointFrame *points, size_t max){
+  uint32_t first = firstSeq();
+  // unsigned, so this is right when the sequence numbers wrap
+  if(*seq - first > (uint32_t)_records.size()){
+    *seq = first;
+  }
+  size_t offset = *seq - first;
+  size_t count = 0;
+  while(count < max && offset + count < _records.size()){
+    toPoint(_records[offset + count], &points[count]);
+    count++;
+  }
+  return(count);
+}
+
+
+/*
+ * The datapoint with sequence number seq
+ * If it isn't held (any more) it gives the nearest one that is. Only call when not empty.
+ */
+void RoastHistory::get(uint32_t seq, DatapointFrame *point){
+  uint32_t offset = seq - firstSeq();
+  if(offset >= _records.size()){
+    // before the first one (the unsigned subtraction wrapped) or after the last
+    offset = (int32_t)offset < 0 ? 0 : _records.size() - 1;
+  }
+  toPoint(_records[offset], point);
+}
+
+
+uint32_t RoastHistory::firstSeq(){
+  return(_nextSeq - _records.size());
+}
+
+uint32_t RoastHistory::nextSeq(){
+  return(_nextSeq);
+}
+
+size_t RoastHistory::size(){
+  return(_records.size());
+}
@@ -0,0 +1,56 @@
+/*
+ * In-RAM history of the current roast
+ * Every published datapoint is kept as a compact fixed size record (12 bytes), numbered with a sequence number,
+ * so a browser that reconnects can ask for everything after the last sample it has.
+ *
+ * The last HISTORY_CAPACITY records are kept, older ones are dropped. That is a number of samples, not a time:
+ * 34 minutes at the default 2 s sample interval, but only 1.7 minutes at FAST_SAMPLE_INTERVAL (100 ms), so a
+ * client reconnecting to a fast sampled roast only gets the end of it. The "history_span" status parameter says
+ * how far back it goes at the current interval. It is 12KB of static DRAM on the ESP8266.
+ * Sequence numbers keep counting up across roasts and never repeat (until they wrap at 2^32).
+ * A datapoint with an earlier timestamp than the last one means the controller was restarted, so the history
+ * is cleared and starts again with the new roast.
+ *
+ * The records are stored at a lower resolution than the live datapoints:
+ * temperatures to 0.1 oC, output to 0.01%, timestamps to 1 ms.
+ */
+#ifndef ROASTHISTORY_H
+#define ROASTHISTORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "dataFrame.h"
+#include "ringBuffer.h"
+
+#define HISTORY_CAPACITY 1024  // records of 12 bytes
+
+struct HistoryRecord {
+  uint32_t timestamp;   // [ms]
+  int16_t setpoint;     // [0.1 oC]
+  int16_t temperature;  // [0.1 oC], HISTORY_NO_TEMPERATURE if there wasn't one (thermocouple fault)
+  uint16_t output;      // [0.01 %]
+  uint16_t reserved;
+};
+
+#define HISTORY_NO_TEMPERATURE INT16_MIN
+
+class RoastHistory {
+ public:
+  RoastHistory();
+
+  uint32_t add(const DatapointFrame &point);
+  void clear();
+  size_t read(uint32_t *seq, DatapointFrame *points, size_t max);
+  void get(uint32_t seq, DatapointFrame *point);
+
+  uint32_t firstSeq();
+  uint32_t nextSeq();
+  size_t size();
+
+ private:
+  RingBuffer<HistoryRecord, HISTORY_CAPACITY> _records;
+  uint32_t _nextSeq;
+  uint32_t _lastTimestamp;
+};
+
+#endif  // ROASTHISTORY_H
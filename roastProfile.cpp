@@ -0,0 +1,192 @@
+#include "roastProfile.h"
+#include <string.h>
+#include <math.h>
+
+
+RoastProfile::RoastProfile(){
+  clear();
+}
+
+
+/*
+ * Forget the profile (and its compiled segments)
+ */
+void RoastProfile::clear(){
+  _name[0] = '\0';
+  _preheat = 0;
+  _numSteps = 0;
+  _numSegments = 0;
+  _duration = 0;
+  _segment = 0;
+  _inSegment = 0;
+  _elapsed = 0;
+  _setpoint = 0;
+}
+
+
+void RoastProfile::setName(const char *name){
+  strncpy(_name, name ? name : "", PROFILE_NAME_LENGTH - 1);
+  _name[PROFILE_NAME_LENGTH - 1] = '\0';
+}
+
+const char *RoastProfile::getName() const{
+  return(_name);
+}
+
+
+/*
+ * The temperature to preheat to before the beans go in, and where the first step ramps from [oC]
+ */
+bool RoastProfile::setPreheat(float temperature){
+  if(!(temperature >= 0 && temperature <= PROFILE_MAX_TEMPERATURE)){
+    return(false);
+  }
+  _preheat = temperature;
+  return(true);
+}
+
+float RoastProfile::getPreheat() const{
+  return(_preheat);
+}
+
+
+/*
+ * Add a step: ramp to target [oC] at rampRate [oC/min] (0 = straight there), then hold it for holdTime [s]
+ * Returns false if the profile is full or the step doesn't make sense (NaNs fail every test here)
+ */
+bool RoastProfile::addStep(float target, float rampRate, float holdTime){
+  if(_numSteps >= PROFILE_MAX_STEPS || !(target >= 0 && target <= PROFILE_MAX_TEMPERATURE) ||
+     !(rampRate >= 0 && rampRate < INFINITY) || !(holdTime >= 0 && holdTime < INFINITY)){
+    return(false);
+  }
+  _steps[_numSteps].target = target;
+  _steps[_numSteps].rampRate = rampRate;
+  _steps[_numSteps].holdTime = holdTime;
+  _numSteps++;
+  return(true);
+}
+
+uint8_t RoastProfile::stepCount() const{
+  return(_numSteps);
+}
+
+
+/*
+ * Turn the steps into the segment table, ready for begin()
+ * Returns false if there are no steps
+ */
+bool RoastProfile::compile(){
+  _numSegments = 0;
+  _duration = 0;
+  if(_numSteps == 0){
+    return(false);
+  }
+
+  float from = _preheat;
+  for(uint8_t s=0; s<_numSteps; s++){
+    const ProfileStep &step = _steps[s];
+    ProfileSegment &ramp = _segments[_numSegments++];
+    float change = step.target - from;
+    ramp.kind = SEGMENT_RAMP;
+    ramp.target = step.target;
+    if(step.rampRate > 0 && change != 0){
+      ramp.rate = (change > 0 ? step.rampRate : -step.rampRate)/60;
+      ramp.duration = fabsf(change)/(step.rampRate/60);
+    }else{
+      ramp.rate = 0;
+      ramp.duration = 0;
+    }
+    _duration += ramp.duration;
+
+    if(step.holdTime > 0){
+      ProfileSegment &hold = _segments[_numSegments++];
+      hold.kind = SEGMENT_HOLD;
+      hold.target = step.target;
+      hold.rate = 0;
+      hold.duration = step.holdTime;
+      _duration += hold.duration;
+    }
+    from = step.target;
+  }
+  begin();
+  return(true);
+}
+
+uint8_t RoastProfile::segmentCount() const{
+  return(_numSegments);
+}
+
+const ProfileSegment &RoastProfile::segment(uint8_t s) const{
+  return(_segments[s]);
+}
+
+/*
+ * How long the roast takes from begin() to done() [s]
+ */
+float RoastProfile::duration() const{
+  return(_duration);
+}
+
+
+/*
+ * Start the roast from the preheat temperature at the first segment
+ */
+void RoastProfile::begin(){
+  _segment = 0;
+  _inSegment = 0;
+  _elapsed = 0;
+  _setpoint = _preheat;
+  // straight to the first target if that's what the first step says
+  advance(0);
+}
+
+
+/*
+ * Move the roast on by dt [s], returns the new setpoint [oC]
+ * Usually that is inside the current segment. If dt runs past its end the setpoint lands exactly on its
+ * target and the rest of dt carries on into the next one.
+ */
+float RoastProfile::advance(float dt){
+  while(_segment < _numSegments){
+    const ProfileSegment &segment = _segments[_segment];
+    float left = segment.duration - _inSegment;
+    if(dt < left){
+      _inSegment += dt;
+      _elapsed += dt;
+      _setpoint += segment.rate*dt;
+      return(_setpoint);
+    }
+    dt -= left;
+    _elapsed += left;
+    _setpoint = segment.target;
+    _segment++;
+    _inSegment = 0;
+  }
+  return(_setpoint);
+}
+
+float RoastProfile::getSetpoint() const{
+  return(_setpoint);
+}
+
+/*
+ * The segment the roast is in, segmentCount() once it has finished
+ */
+uint8_t RoastProfile::currentSegment() const{
+  return(_segment);
+}
+
+/*
+ * Whether the roast is ramping or holding, SEGMENT_HOLD once it has finished
+ */
+uint8_t RoastProfile::currentKind() const{
+  return(_segment < _numSegments ? _segments[_segment].kind : (uint8_t)SEGMENT_HOLD);
+}
+
+float RoastProfile::getElapsed() const{
+  return(_elapsed);
+}
+
+bool RoastProfile::done() const{
+  return(_segment >= _numSegments);
+}
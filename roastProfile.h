@@ -0,0 +1,80 @@
+/*
+ * Ramp/soak roast profile for program mode
+ * A profile is a preheat temperature and up to PROFILE_MAX_STEPS steps. Each step ramps the setpoint to its
+ * target temperature at its ramp rate [oC/min] (0 to go straight there) and then holds it for its hold time [s].
+ * The controller cools down after the last one.
+ *
+ * compile() turns the steps into a table of segments, each a straight line of the setpoint: the temperature it
+ * ends at, how fast it gets there [oC/s] (signed, so it can ramp down too), how long it takes and whether it is a
+ * ramp or a hold. A step straight to its target is a zero length ramp, a step with no hold time has no hold.
+ * While the roast runs, advance() moves the setpoint on by rate*dt and goes on to the next segment once the
+ * current one has run its length, so a tick is a few float operations: no searching for where we are, no allocation.
+ */
+#ifndef ROASTPROFILE_H
+#define ROASTPROFILE_H
+
+#include <stdint.h>
+
+#define PROFILE_MAX_STEPS 8
+#define PROFILE_MAX_SEGMENTS (2*PROFILE_MAX_STEPS)
+#define PROFILE_NAME_LENGTH 24
+#define PROFILE_MAX_TEMPERATURE 300  // [oC], the same as the setpoint parameter
+
+enum SegmentKind {SEGMENT_RAMP, SEGMENT_HOLD};
+
+struct ProfileStep {
+  float target;    // [oC]
+  float rampRate;  // [oC/min], 0 to go straight to the target
+  float holdTime;  // [s]
+};
+
+struct ProfileSegment {
+  float target;    // setpoint at the end [oC]
+  float rate;      // [oC/s]
+  float duration;  // [s]
+  uint8_t kind;    // SegmentKind
+};
+
+class RoastProfile {
+ public:
+  RoastProfile();
+
+  void clear();
+  void setName(const char *name);
+  const char *getName() const;
+  bool setPreheat(float temperature);
+  float getPreheat() const;
+  bool addStep(float target, float rampRate, float holdTime);
+  uint8_t stepCount() const;
+  bool compile();
+
+  uint8_t segmentCount() const;
+  const ProfileSegment &segment(uint8_t s) const;
+  float duration() const;
+
+  void begin();
+  float advance(float dt);
+  float getSetpoint() const;
+  uint8_t currentSegment() const;
+  uint8_t currentKind() const;
+  float getElapsed() const;
+  bool done() const;
+
+ private:
+  char _name[PROFILE_NAME_LENGTH];
+  float _preheat;
+  ProfileStep _steps[PROFILE_MAX_STEPS];
+  uint8_t _numSteps;
+
+  ProfileSegment _segments[PROFILE_MAX_SEGMENTS];
+  uint8_t _numSegments;
+  float _duration;
+
+  // where the roast has got to
+  uint8_t _segment;
+  float _inSegment;  // time into the current segment [s]
+  float _elapsed;    // time since begin() [s]
+  float _setpoint;
+};
+
+#endif  // ROASTPROFILE_H
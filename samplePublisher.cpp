@@ -0,0 +1,88 @@
+#include "samplePublisher.h"
+
+
+SamplePublisher::SamplePublisher(PublishCallback callback) : _callback(callback) {
+  setInterval(PUBLISH_INTERVAL);
+  setBatchSize(PUBLISH_BATCH_SIZE);
+  _lastFlushMicros = micros();
+  _samples = 0;
+  _frames = 0;
+}
+
+
+/*
+ * Add a datapoint (timestamp [s]), and send the batch if it is due
+ */
+void SamplePublisher::add(double timestamp, double setpoint, double output, double temperature){
+  DatapointFrame sample;
+  sample.timestamp = (uint32_t)(timestamp*1000 + 0.5);
+  sample.setpoint = (float)setpoint;
+  sample.output = (float)output;
+  sample.temperature = (float)temperature;
+  add(sample);
+}
+
+void SamplePublisher::add(const DatapointFrame &sample){
+  _pending.push(sample);
+  _samples++;
+  if(_pending.size() >= _batchSize || (uint32_t)(micros() - _lastFlushMicros) >= _intervalUs){
+    flush();
+  }
+}
+
+
+void SamplePublisher::process(){
+  if(!_pending.empty() && (uint32_t)(micros() - _lastFlushMicros) >= _intervalUs){
+    flush();
+  }
+}
+
+
+/*
+ * Send whatever is waiting, now
+ */
+void SamplePublisher::flush(){
+  _lastFlushMicros = micros();
+  if(_pending.empty()){
+    return;
+  }
+  DatapointFrame batch[PUBLISH_CAPACITY];
+  size_t count = 0;
+  while(!_pending.empty()){
+    batch[count++] = _pending.pop();
+  }
+  _frames++;
+  if(_callback){
+    _callback(batch, count);
+  }
+}
+
+
+void SamplePublisher::setInterval(unsigned long interval){
+  _intervalUs = interval*1000;
+}
+
+unsigned long SamplePublisher::getInterval(){
+  return(_intervalUs/1000);
+}
+
+void SamplePublisher::setBatchSize(size_t batchSize){
+  if(batchSize < 1){
+    batchSize = 1;
+  }else if(batchSize > PUBLISH_CAPACITY){
+    batchSize = PUBLISH_CAPACITY;
+  }
+  _batchSize = batchSize;
+}
+
+size_t SamplePublisher::getBatchSize(){
+  return(_batchSize);
+}
+
+unsigned long SamplePublisher::getSamples(){
+  return(_samples);
+}
+
+unsigned long SamplePublisher::getFrames(){
+  return(_frames);
+}
@@ -0,0 +1,54 @@
+/*
+ * Batched datapoint publishing
+ * Collects datapoints in a ring buffer and hands them to the callback several at a time, so the web layer can
+ * send one websocket frame per batch instead of one per sample.
+ *
+ * A batch goes out when it reaches the batch size, or when the flush interval has passed since the last one.
+ * At the default 2 s sample interval that is every sample, as soon as it is added. At 10Hz it is a frame
+ * every PUBLISH_INTERVAL ms.
+ * add() flushes itself when a batch is due, process() needs to be called every main loop to flush on time
+ * when samples stop coming.
+ *
+ * The batch size is limited to the buffer capacity, so nothing is ever overwritten.
+ */
+#ifndef SAMPLEPUBLISHER_H
+#define SAMPLEPUBLISHER_H
+
+#include <Arduino.h>
+#include "dataFrame.h"
+#include "ringBuffer.h"
+
+#define PUBLISH_CAPACITY 32
+#define PUBLISH_INTERVAL 500     // [ms]
+#define PUBLISH_BATCH_SIZE 10
+
+typedef void (*PublishCallback)(const DatapointFrame *samples, size_t count);
+
+class SamplePublisher {
+ public:
+  SamplePublisher(PublishCallback callback);
+
+  void add(double timestamp, double setpoint, double output, double temperature);
+  void add(const DatapointFrame &sample);
+  void process();
+  void flush();
+
+  void setInterval(unsigned long interval);
+  unsigned long getInterval();
+  void setBatchSize(size_t batchSize);
+  size_t getBatchSize();
+
+  unsigned long getSamples();
+  unsigned long getFrames();
+
+ private:
+  RingBuffer<DatapointFrame, PUBLISH_CAPACITY> _pending;
+  PublishCallback _callback;
+  unsigned long _intervalUs;
+  size_t _batchSize;
+  uint32_t _lastFlushMicros;
+  unsigned long _samples;
+  unsigned long _frames;
+};
+
+#endif  // SAMPLEPUBLISHER_H
@@ -0,0 +1,125 @@
+#include "scheduler.h"
+
+Scheduler scheduler;
+
+
+Scheduler::Scheduler(){
+  _count = 0;
+  _running = NUM_PRIORITIES;
+}
+
+
+/*
+ * Add a task, first due now. Returns its number, -1 if the table is full.
+ */
+int8_t Scheduler::add(const char *name, TaskFunction run, TaskPriority priority, unsigned long periodUs, unsigned long deadlineUs){
+  if(_count >= SCHEDULER_MAX_TASKS){
+    return(-1);
+  }
+  Task &task = _tasks[_count];
+  task.name = name;
+  task.run = run;
+  task.priority = periodUs == 0 ? PRIORITY_IDLE : priority;
+  task.periodUs = periodUs;
+  task.deadlineUs = deadlineUs;
+  task.due = micros();
+  task.runs = 0;
+  task.lateness.clear();
+  task.lateness.setLimit(deadlineUs);
+  return(_count++);
+}
+
+
+/*
+ * Run the most urgent task which is due, or if none is all the idle tasks
+ * Returns true if a task was due.
+ */
+bool Scheduler::runOnce(){
+  uint32_t now = micros();
+  int8_t t = mostUrgent(NUM_PRIORITIES, now);
+  if(t >= 0){
+    run(t, now);
+    return(true);
+  }
+  for(uint8_t i=0; i<_count; i++){
+    if(_tasks[i].periodUs == 0){
+      run(i, micros());
+    }
+  }
+  return(false);
+}
+
+
+/*
+ * From inside a task: run everything of higher priority which is due, most urgent first
+ * Returns the number of tasks run.
+ */
+uint8_t Scheduler::yield(){
+  uint8_t ran = 0;
+  int8_t t;
+  uint32_t now = micros();
+  while((t = mostUrgent(_running, now)) >= 0){
+    run(t, now);
+    ran++;
+    now = micros();
+  }
+  return(ran);
+}
+
+
+/*
+ * The due periodic task with a priority above priority which has been due longest, -1 if there isn't one
+ */
+int8_t Scheduler::mostUrgent(uint8_t priority, uint32_t now){
+  int8_t best = -1;
+  for(uint8_t i=0; i<_count; i++){
+    const Task &task = _tasks[i];
+    // signed, so a task due a little in the future isn't taken as very late
+    if(task.periodUs == 0 || task.priority >= priority || (int32_t)(now - task.due) < 0){
+      continue;
+    }
+    if(best < 0 || task.priority < _tasks[best].priority ||
+       (task.priority == _tasks[best].priority && now - task.due > now - _tasks[best].due)){
+      best = i;
+    }
+  }
+  return(best);
+}
+
+
+void Scheduler::run(uint8_t t, uint32_t now){
+  Task &task = _tasks[t];
+  if(task.periodUs){
+    task.lateness.add(now - task.due);
+    task.due += task.periodUs;
+    if((int32_t)(now - task.due) >= 0){
+      task.due = now + task.periodUs;
+    }
+  }
+  task.runs++;
+  uint8_t running = _running;
+  _running = task.priority;
+  task.run();
+  _running = running;
+}
+
+
+void Scheduler::clear(){
+  for(uint8_t i=0; i<_count; i++){
+    _tasks[i].runs = 0;
+    _tasks[i].lateness.clear();
+  }
+}
+
+
+uint8_t Scheduler::count(){
+  return(_count);
+}
+
+Task &Scheduler::task(uint8_t t){
+  return(_tasks[t]);
+}
+
+uint32_t Scheduler::getMisses(uint8_t t){
+  return(_tasks[t].lateness.getOverruns());
+}
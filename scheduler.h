@@ -0,0 +1,63 @@
+/*
+ * Cooperative deadline scheduler for loop()
+ * The main loop is a fixed table of tasks, each with a priority, a period and a deadline. Every loop() runs the one
+ * most urgent task that is due: the highest priority, and of those the one which has been due longest. A task
+ * starting more than its deadline after it was due is a miss; how late each run started goes in a histogram
+ * (in us, see latencyHistogram.h) whose overruns are the misses.
+ * Tasks with period 0 are idle work, run when nothing else is due.
+ *
+ * Nothing is preempted, so a task which could take a long time (streaming a file to the browser) does its work in
+ * slices and calls yield() between them, which runs anything of higher priority that has come due.
+ * A periodic task which falls more than a period behind skips the runs it missed rather than catching up.
+ *
+ * Times are micros(), wrap safe.
+ */
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+#include "latencyHistogram.h"
+
+#define SCHEDULER_MAX_TASKS 8
+
+typedef void (*TaskFunction)(void);
+
+// the order is the priority, highest first
+enum TaskPriority {PRIORITY_CONTROL, PRIORITY_TRIAC, PRIORITY_WEBSOCKET, PRIORITY_HTTP, PRIORITY_IDLE, NUM_PRIORITIES};
+
+struct Task {
+  const char *name;
+  TaskFunction run;
+  uint8_t priority;
+  unsigned long periodUs;     // 0 = idle work
+  unsigned long deadlineUs;
+  uint32_t due;               // [us] when it is next due
+  uint32_t runs;
+  LatencyHistogram lateness;  // [us] how long after it was due each run started
+};
+
+class Scheduler {
+ public:
+  Scheduler();
+
+  int8_t add(const char *name, TaskFunction run, TaskPriority priority, unsigned long periodUs, unsigned long deadlineUs);
+  bool runOnce();
+  uint8_t yield();
+  void clear();
+
+  uint8_t count();
+  Task &task(uint8_t t);
+  uint32_t getMisses(uint8_t t);
+
+ private:
+  int8_t mostUrgent(uint8_t priority, uint32_t now);
+  void run(uint8_t t, uint32_t now);
+
+  Task _tasks[SCHEDULER_MAX_TASKS];
+  uint8_t _count;
+  uint8_t _running;  // priority of the task running now, NUM_PRIORITIES when none is
+};
+
+extern Scheduler scheduler;
+
+#endif  // SCHEDULER_H
@@ -0,0 +1,93 @@
+/*
+ * Lock-free single producer, single consumer ring
+ * N fixed size slots (N a power of 2). The producer fills a slot in place (claim(), then publish()) and the
+ * consumer reads it in place (front(), then pop()), so nothing is copied twice and neither side ever waits:
+ * claim() on a full ring returns NULL and the producer decides what to drop.
+ *
+ * The head is only written by the producer and the tail only by the consumer. They are free running 32 bit
+ * counters (the slot is the counter mod N), so full is head - tail == N and no slot is wasted.
+ * On the ESP8266 (one core, in order) a compiler barrier is enough to keep the slot contents ahead of the index
+ * which publishes them; the host build uses acquire/release atomics so the producer and consumer can be threads.
+ */
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef HOST_BUILD
+static inline uint32_t spscLoad(const volatile uint32_t *index){ return(__atomic_load_n(index, __ATOMIC_ACQUIRE)); }
+static inline void spscStore(volatile uint32_t *index, uint32_t value){ __atomic_store_n(index, value, __ATOMIC_RELEASE); }
+#else
+static inline uint32_t spscLoad(const volatile uint32_t *index){
+  uint32_t value = *index;
+  __asm__ __volatile__("" ::: "memory");
+  return(value);
+}
+static inline void spscStore(volatile uint32_t *index, uint32_t value){
+  __asm__ __volatile__("" ::: "memory");
+  *index = value;
+}
+#endif
+
+template <typename T, size_t N>
+class SpscRing {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "the ring size must be a power of 2");
+
+ public:
+  SpscRing() : _head(0), _tail(0) {}
+
+  // producer: the next free slot to fill, NULL if full
+  T *claim(){
+    uint32_t head = _head;
+    return(head - spscLoad(&_tail) >= N ? NULL : &_items[head & (N - 1)]);
+  }
+
+  // producer: hand the claimed slot over to the consumer
+  void publish(){
+    spscStore(&_head, _head + 1);
+  }
+
+  bool push(const T &item){
+    T *slot = claim();
+    if(!slot){
+      return(false);
+    }
+    *slot = item;
+    publish();
+    return(true);
+  }
+
+  // consumer: the oldest slot, NULL if empty
+  T *front(){
+    uint32_t tail = _tail;
+    return(tail == spscLoad(&_head) ? NULL : &_items[tail & (N - 1)]);
+  }
+
+  // consumer: give the front slot back to the producer
+  void pop(){
+    spscStore(&_tail, _tail + 1);
+  }
+
+  bool pop(T *item){
+    T *slot = front();
+    if(!slot){
+      return(false);
+    }
+    *item = *slot;
+    pop();
+    return(true);
+  }
+
+  // either side, a snapshot
+  size_t size() const { return spscLoad(&_head) - spscLoad(&_tail); }
+  bool empty() const { return size() == 0; }
+  size_t capacity() const { return N; }
+
+ private:
+  T _items[N];
+  volatile uint32_t _head;   // slots published, written by the producer
+  volatile uint32_t _tail;   // slots consumed, written by the consumer
+};
+
+#endif  // SPSCRING_H
@@ -0,0 +1,125 @@
+#include "subscriptions.h"
+#include <string.h>
+
+
+static const char *topicNames[NUM_TOPICS] = {"samples", "status", "logs", "diagnostics"};
+
+
+Subscriptions::Subscriptions(uint8_t maxClients){
+  _maxClients = maxClients > SUBSCRIPTIONS_MAX_CLIENTS ? SUBSCRIPTIONS_MAX_CLIENTS : maxClients;
+  for(uint8_t t=0; t<NUM_TOPICS; t++){
+    _subscribers[t] = 0;
+    _started[t] = 0;
+  }
+  for(uint8_t num=0; num<_maxClients; num++){
+    reset(num);
+  }
+}
+
+
+/*
+ * Back to the default topics, at every update (when client num connects)
+ */
+void Subscriptions::reset(uint8_t num){
+  if(num >= _maxClients){
+    return;
+  }
+  for(uint8_t t=0; t<NUM_TOPICS; t++){
+    if(TOPICS_DEFAULT & (1 << t)){
+      _subscribers[t] |= 1UL << num;
+    }else{
+      _subscribers[t] &= ~(1UL << num);
+    }
+    _started[t] &= ~(1UL << num);
+    _interval[num][t] = 0;
+  }
+}
+
+
+/*
+ * Subscribe client num to topic, at no more than rate [Hz] (0 = every update)
+ * Subscribing again just changes the rate.
+ */
+void Subscriptions::subscribe(uint8_t num, Topic topic, double rate){
+  if(num >= _maxClients || topic >= NUM_TOPICS){
+    return;
+  }
+  _subscribers[topic] |= 1UL << num;
+  _interval[num][topic] = rate > 0 ? (unsigned long)(1000/rate + 0.5) : 0;
+}
+
+void Subscriptions::unsubscribe(uint8_t num, Topic topic){
+  if(num >= _maxClients || topic >= NUM_TOPICS){
+    return;
+  }
+  _subscribers[topic] &= ~(1UL << num);
+}
+
+
+uint32_t Subscriptions::subscribers(Topic topic){
+  return(topic < NUM_TOPICS ? _subscribers[topic] : 0);
+}
+
+/*
+ * The subscribers which get every update
+ */
+uint32_t Subscriptions::unlimited(Topic topic){
+  if(topic >= NUM_TOPICS){
+    return(0);
+  }
+  uint32_t mask = 0;
+  for(uint8_t num=0; num<_maxClients; num++){
+    if((_subscribers[topic] & (1UL << num)) && _interval[num][topic] == 0){
+      mask |= 1UL << num;
+    }
+  }
+  return(mask);
+}
+
+bool Subscriptions::subscribed(uint8_t num, Topic topic){
+  return(num < _maxClients && topic < NUM_TOPICS && (_subscribers[topic] & (1UL << num)));
+}
+
+
+/*
+ * Is it time to send client num another on topic
+ */
+bool Subscriptions::due(uint8_t num, Topic topic, uint32_t time){
+  if(!subscribed(num, topic)){
+    return(false);
+  }
+  if(!(_started[topic] & (1UL << num)) || _interval[num][topic] == 0){
+    return(true);
+  }
+  // unsigned, so a time going backwards (eg. the controller restarted) is a long way forward, and due
+  return((uint32_t)(time - _last[num][topic]) >= _interval[num][topic]);
+}
+
+void Subscriptions::sent(uint8_t num, Topic topic, uint32_t time){
+  if(num >= _maxClients || topic >= NUM_TOPICS){
+    return;
+  }
+  _last[num][topic] = time;
+  _started[topic] |= 1UL << num;
+}
+
+unsigned long Subscriptions::getInterval(uint8_t num, Topic topic){
+  return(num < _maxClients && topic < NUM_TOPICS ? _interval[num][topic] : 0);
+}
+
+
+/*
+ * The topic called name, -1 if there isn't one
+ */
+int8_t Subscriptions::find(const char *name){
+  for(uint8_t t=0; t<NUM_TOPICS; t++){
+    if(strcmp(topicNames[t], name) == 0){
+      return(t);
+    }
+  }
+  return(-1);
+}
+
+const char *Subscriptions::name(Topic topic){
+  return(topic < NUM_TOPICS ? topicNames[topic] : "");
+}
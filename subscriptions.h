@@ -0,0 +1,51 @@
+/*
+ * Websocket topic subscriptions
+ * Each client picks which topics it gets (samples, status, logs, diagnostics), and how often at most, as a rate
+ * in Hz (0 = every update). A wall display can take the status once a second while a tuning laptop takes
+ * every sample.
+ *
+ * Rates are kept as a minimum interval per client and topic. due() says whether that long has passed since
+ * the last one the client was sent, and sent() records it once it has actually gone. The times are whatever
+ * the caller uses for that topic: the sample timestamps for samples (so it is the samples which are spaced
+ * out, however they are batched), millis() for the rest. A time going backwards counts as due.
+ *
+ * A new client gets samples, status and logs at every update (what everyone got before there were topics).
+ */
+#ifndef SUBSCRIPTIONS_H
+#define SUBSCRIPTIONS_H
+
+#include <stdint.h>
+
+#define SUBSCRIPTIONS_MAX_CLIENTS 32
+
+enum Topic {TOPIC_SAMPLES, TOPIC_STATUS, TOPIC_LOGS, TOPIC_DIAGNOSTICS, NUM_TOPICS};
+
+#define TOPICS_DEFAULT ((1 << TOPIC_SAMPLES) | (1 << TOPIC_STATUS) | (1 << TOPIC_LOGS))
+
+class Subscriptions {
+ public:
+  Subscriptions(uint8_t maxClients);
+
+  void reset(uint8_t num);
+  void subscribe(uint8_t num, Topic topic, double rate);
+  void unsubscribe(uint8_t num, Topic topic);
+
+  uint32_t subscribers(Topic topic);
+  uint32_t unlimited(Topic topic);
+  bool subscribed(uint8_t num, Topic topic);
+  bool due(uint8_t num, Topic topic, uint32_t time);
+  void sent(uint8_t num, Topic topic, uint32_t time);
+  unsigned long getInterval(uint8_t num, Topic topic);
+
+  static int8_t find(const char *name);
+  static const char *name(Topic topic);
+
+ private:
+  uint8_t _maxClients;
+  uint32_t _subscribers[NUM_TOPICS];  // one bit per client
+  uint32_t _started[NUM_TOPICS];      // has been sent one, so _last means something
+  unsigned long _interval[SUBSCRIPTIONS_MAX_CLIENTS][NUM_TOPICS];
+  uint32_t _last[SUBSCRIPTIONS_MAX_CLIENTS][NUM_TOPICS];
+};
+
+#endif  // SUBSCRIPTIONS_H
@@ -0,0 +1,88 @@
+#include "thermocouple.h"
+
+
+Thermocouple::Thermocouple(int8_t cs) : _max31855(cs) {
+  _temperature = NAN;
+  _fault = 0;
+  _faultCount = 0;
+  _prevMicros = micros();
+  _lastGoodMicros = _prevMicros;
+}
+
+
+void Thermocouple::begin(){
+  _max31855.begin();
+  _samples.clear();
+  sample();
+}
+
+
+/*
+ * Take a sample if it is time to
+ */
+void Thermocouple::process(){
+  if((uint32_t)(micros() - _prevMicros) >= TC_SAMPLE_INTERVAL_US){
+    sample();
+  }
+}
+
+
+void Thermocouple::sample(){
+  _prevMicros = micros();
+  double t = _max31855.readCelsius();
+  if(isnan(t)){
+    // the library returns NAN when any fault bit is set. Only ask which one when there is one.
+    _fault = _max31855.readError();
+    _faultCount++;
+    return;
+  }
+  _fault = 0;
+  // don't mix in samples from before a long fault
+  if(_prevMicros - _lastGoodMicros >= TC_STALE_MS*1000UL){
+    _samples.clear();
+  }
+  _lastGoodMicros = _prevMicros;
+  _samples.push(t);
+
+  // median of the buffer. Small enough that an insertion sort is the quickest.
+  double sorted[TC_FILTER_SAMPLES];
+  size_t n = _samples.size();
+  for(size_t i=0; i<n; i++){
+    double v = _samples[i];
+    size_t j = i;
+    while(j > 0 && sorted[j-1] > v){
+      sorted[j] = sorted[j-1];
+      j--;
+    }
+    sorted[j] = v;
+  }
+  if(n % 2){
+    _temperature = sorted[n/2];
+  }else{
+    _temperature = (sorted[n/2 - 1] + sorted[n/2])/2;
+  }
+}
+
+
+double Thermocouple::getTemperature(){
+  if(!isValid()){
+    return(NAN);
+  }
+  return(_temperature);
+}
+
+unsigned long Thermocouple::getAge(){
+  return((uint32_t)(micros() - _lastGoodMicros)/1000);
+}
+
+uint8_t Thermocouple::getFault(){
+  return(_fault);
+}
+
+bool Thermocouple::isValid(){
+  return(!_samples.empty() && getAge() < TC_STALE_MS);
+}
+
+unsigned long Thermocouple::getFaultCount(){
+  return(_faultCount);
+}
@@ -0,0 +1,56 @@
+/*
+ * Thermocouple acquisition
+ * Wraps the MAX31855 and samples it on its own schedule (every TC_SAMPLE_INTERVAL_US, the chip's conversion time)
+ * from process(), which needs to be called every main loop.
+ * Nothing else talks to the chip. Everyone (the PID, the websocket status, the datapoints) gets the cached
+ * filtered value from getTemperature(), so they all see the same number and status requests cause no SPI traffic.
+ *
+ * Good samples go into a small ring buffer and the temperature is the median of the last TC_FILTER_SAMPLES,
+ * which throws away single sample spikes (eg. noise from the triac switching) without much lag.
+ *
+ * A read the chip flags as a fault is not put in the buffer. getFault() gives the flags from the last read
+ * (TC_FAULT_OPEN/TC_FAULT_SHORT_GND/TC_FAULT_SHORT_VCC, 0 when it was good).
+ * isValid() is false when there hasn't been a good sample for TC_STALE_MS, and getTemperature() is then NAN.
+ */
+#ifndef THERMOCOUPLE_H
+#define THERMOCOUPLE_H
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "Adafruit_MAX31855.h"
+#include "ringBuffer.h"
+
+#define TC_SAMPLE_INTERVAL_US 100000
+#define TC_FILTER_SAMPLES 5
+#define TC_STALE_MS 1000
+
+// MAX31855 fault bits, as returned by readError()
+#define TC_FAULT_OPEN 0x01
+#define TC_FAULT_SHORT_GND 0x02
+#define TC_FAULT_SHORT_VCC 0x04
+
+class Thermocouple {
+ public:
+  Thermocouple(int8_t cs);
+
+  void begin();
+  void process();
+  void sample();
+
+  double getTemperature();
+  unsigned long getAge();   // time since the last good sample [ms]
+  uint8_t getFault();
+  bool isValid();
+  unsigned long getFaultCount();
+
+ private:
+  Adafruit_MAX31855 _max31855;
+  RingBuffer<double, TC_FILTER_SAMPLES> _samples;
+  double _temperature;           // filtered
+  uint8_t _fault;
+  unsigned long _faultCount;
+  uint32_t _prevMicros;          // last sample (good or bad)
+  uint32_t _lastGoodMicros;
+};
+
+#endif  // THERMOCOUPLE_H
@@ -1,46 +1,163 @@
 /*
- * Burst mode triac controller
+ * Burst mode / sigma-delta triac controller
  */
 #include <Arduino.h>
 #include "triacOutput.h"
-#include "webserver.h"
+#include "loopStats.h"
+
+// timer1 runs at 80MHz/16 = 5 ticks per us
+#define TIMER1_TICKS_PER_US 5
+
+TriacOutput *TriacOutput::_timerOutput = NULL;
 
 
 TriacOutput::TriacOutput(int8_t triggerPin_in){
   triggerPin = triggerPin_in;
-  period = TRIAC_PWM_PERIOD_MS;
+  periodTicks = (TRIAC_PWM_PERIOD_MS*1000UL)/TRIAC_TICK_US;
+  slotTicks = TRIAC_HALF_CYCLE_US/TRIAC_TICK_US;
   periodStartTime = 0;
+  tickCount = 0;
   duty_cycle = 0;
+  onTicks = 0;
+  sdLevel = 0;
+  sdAccumulator = 0;
+  slotOn = 0;
   enabled = 0;
+  pinState = 0;
+  _drive = TRIAC_POLLED;
+  _distribution = TRIAC_BURST;
   pinMode(triggerPin, OUTPUT);
   digitalWrite(triggerPin, LOW);
 }
 
 void TriacOutput::enable(){
   if(!enabled){
-    enabled = 1;
-    periodStartTime = millis();
+    periodStartTime = micros();
+    tickCount = 0;
+    pinState = 0;
+    sdAccumulator = 0;
+    slotOn = nextSlot();
     digitalWrite(triggerPin, LOW);
+    enabled = 1;
+    if(_drive == TRIAC_TIMER){
+      startTimer();
+    }
   }
 }
 
 void TriacOutput::disable(){
   if(enabled){
     enabled = 0;
+    if(_drive == TRIAC_TIMER){
+      stopTimer();
+    }
+    pinState = 0;
     digitalWrite(triggerPin, LOW);
   }
 }
 
+boolean TriacOutput::isEnabled(){
+  return(enabled);
+}
+
+/*
+ * Set the duty cycle [0, 100] and work out the on time in ticks (burst) and the level (sigma-delta)
+ */
+void TriacOutput::setDutyCycle(double duty_cycle_in){
+  if(duty_cycle_in < 0){
+    duty_cycle_in = 0;
+  }else if(duty_cycle_in > 100){
+    duty_cycle_in = 100;
+  }
+  duty_cycle = duty_cycle_in;
+  onTicks = (unsigned long)(periodTicks*(duty_cycle/100.0) + 0.5);
+  sdLevel = (unsigned long)(TRIAC_SD_RESOLUTION*(duty_cycle/100.0) + 0.5);
+}
+
+double TriacOutput::getDutyCycle(){
+  return(duty_cycle);
+}
+
+/*
+ * Switch between polled and timer driven output. Safe to call while enabled.
+ */
+void TriacOutput::setDrive(TriacDrive drive){
+  if(drive == _drive){
+    return;
+  }
+  if(enabled && _drive == TRIAC_TIMER){
+    stopTimer();
+  }
+  _drive = drive;
+  periodStartTime = micros();
+  tickCount = 0;
+  if(enabled && _drive == TRIAC_TIMER){
+    startTimer();
+  }
+}
+
+TriacDrive TriacOutput::getDrive(){
+  return(_drive);
+}
+
+/*
+ * Switch between burst and sigma-delta. Safe to call while enabled, starts a new period/half cycle.
+ */
+void TriacOutput::setDistribution(TriacDistribution distribution){
+  if(distribution == _distribution){
+    return;
+  }
+  tickCount = 0;
+  periodStartTime = micros();
+  sdAccumulator = 0;
+  slotOn = nextSlot();
+  _distribution = distribution;
+}
+
+TriacDistribution TriacOutput::getDistribution(){
+  return(_distribution);
+}
+
+/*
+ * Step the sigma-delta modulator by one half cycle, returns whether the triac is on for it
+ */
+boolean ICACHE_RAM_ATTR TriacOutput::nextSlot(){
+  sdAccumulator += sdLevel;
+  if(sdAccumulator >= TRIAC_SD_RESOLUTION){
+    sdAccumulator -= TRIAC_SD_RESOLUTION;
+    return(1);
+  }
+  return(0);
+}
+
 /*
- * This has to be called periodically (much faster than the period (~1s))
+ * Polled mode: this has to be called periodically (much faster than the period (~1s))
+ * Timer mode: nothing to do, the interrupt handles it
  */
 void TriacOutput::process(){
+  if(_drive == TRIAC_TIMER){
+    return;
+  }
   if(enabled){
-    unsigned long currentTime = millis();
-    if(currentTime - periodStartTime >= period){
-      periodStartTime = currentTime;
+    uint32_t currentTime = micros();
+    boolean on;
+    if(_distribution == TRIAC_SIGMA_DELTA){
+      unsigned long slotUs = slotTicks*TRIAC_TICK_US;
+      if(currentTime - periodStartTime >= slotUs){
+        loopStats.stage[STAGE_TRIAC_LATE].add(LoopStats::fromMicros(currentTime - periodStartTime - slotUs));
+        periodStartTime = currentTime;
+        slotOn = nextSlot();
+      }
+      on = slotOn;
+    }else{
+      unsigned long periodUs = periodTicks*TRIAC_TICK_US;
+      if(currentTime - periodStartTime >= periodUs){
+        loopStats.stage[STAGE_TRIAC_LATE].add(LoopStats::fromMicros(currentTime - periodStartTime - periodUs));
+        periodStartTime = currentTime;
+      }
+      on = currentTime - periodStartTime < onTicks*TRIAC_TICK_US;
     }
-    if(currentTime - periodStartTime < period*(duty_cycle/100.0)){
+    if(on){
       digitalWrite(triggerPin, HIGH);
     }else{
       digitalWrite(triggerPin, LOW);
@@ -51,4 +168,49 @@ void TriacOutput::process(){
 }
 
 
+void TriacOutput::startTimer(){
+  _timerOutput = this;
+  timer1_attachInterrupt(timerISR);
+  timer1_enable(TIM_DIV16, TIM_EDGE, TIM_LOOP);
+  timer1_write(TRIAC_TICK_US*TIMER1_TICKS_PER_US);
+}
 
+void TriacOutput::stopTimer(){
+  if(_timerOutput == this){
+    timer1_disable();
+    timer1_detachInterrupt();
+    _timerOutput = NULL;
+  }
+}
+
+/*
+ * Runs in interrupt context every TRIAC_TICK_US. Only integer maths, and the pin is only written on a change.
+ */
+void ICACHE_RAM_ATTR TriacOutput::timerTick(){
+  if(_drive != TRIAC_TIMER){
+    return;
+  }
+  boolean on;
+  if(_distribution == TRIAC_SIGMA_DELTA){
+    on = enabled && slotOn;
+    if(++tickCount >= slotTicks){
+      tickCount = 0;
+      slotOn = nextSlot();
+    }
+  }else{
+    on = enabled && tickCount < onTicks;
+    if(++tickCount >= periodTicks){
+      tickCount = 0;
+    }
+  }
+  if(on != pinState){
+    pinState = on;
+    digitalWrite(triggerPin, on ? HIGH : LOW);
+  }
+}
+
+void ICACHE_RAM_ATTR TriacOutput::timerISR(){
+  if(_timerOutput){
+    _timerOutput->timerTick();
+  }
+}
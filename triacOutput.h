@@ -1,35 +1,78 @@
 /*
  * Triac output controller
  * Defines a TriacOutput object which is linked to a particular output pin
- * The output is a pwm signal with duty cycle given by the duty_cycle variable.
- * Create the object (with a pin number) and then set/update the duty_cycle attribute as necessary
+ * The output is a pwm signal with duty cycle given by setDutyCycle().
+ * Create the object (with a pin number) and then set/update the duty cycle as necessary
  * Run enable/disable to enable/disable the output.
- * 
- * process() must be called periodically (ie. every main loop).
- * This object does not use interrupts so you need to call process periodically 
- * (ideally as fast as possible, at least every ~100ms or so)
- * or it will not output the correct duty cycle
+ *
+ * The duty cycle is converted to a whole number of on ticks (TRIAC_TICK_US each) per period when it is set,
+ * so nothing is calculated in floating point while the output is running.
+ *
+ * There are two ways of distributing the on time:
+ *  - TRIAC_BURST: one contiguous on block at the start of every TRIAC_PWM_PERIOD_MS period
+ *  - TRIAC_SIGMA_DELTA: the output is decided every mains half cycle (TRIAC_HALF_CYCLE_US) by a first order
+ *    sigma-delta modulator, so the on half cycles are spread as evenly as possible
+ *    (eg. 25% is on-off-off-off-on-off-off-off...). Much less thermal ripple and 0.1% resolution.
+ *    Relies on the zero crossing triac driver to switch on whole half cycles.
+ *
+ * There are two ways of driving the output:
+ *  - TRIAC_POLLED: process() must be called periodically (ie. every main loop).
+ *    You need to call process periodically (ideally as fast as possible, at least every ~100ms or so)
+ *    or it will not output the correct duty cycle
+ *  - TRIAC_TIMER: hardware timer1 interrupts every tick and switches the output, process() does nothing.
+ *    The timing doesn't depend on how often loop() runs. Only one TriacOutput can use the timer at a time.
  */
 #ifndef OUTPUT_H
 #define OUTPUT_H
 
+#include <Arduino.h>
+
 #define TRIAC_PWM_PERIOD_MS 500
+#define TRIAC_TICK_US 1000
+#define TRIAC_HALF_CYCLE_US 10000   // 50Hz mains
+#define TRIAC_SD_RESOLUTION 1000    // sigma-delta duty cycle steps
+
+enum TriacDrive {TRIAC_POLLED, TRIAC_TIMER};
+enum TriacDistribution {TRIAC_BURST, TRIAC_SIGMA_DELTA};
 
 class TriacOutput {
  public:
-  double duty_cycle; //duty cycle [0, 100]
-  
   TriacOutput(int8_t triggerPin_in);
 
   void enable();
   void disable();
+  boolean isEnabled();
   void process();
 
+  void setDutyCycle(double duty_cycle);
+  double getDutyCycle();  //duty cycle [0, 100]
+  void setDrive(TriacDrive drive);
+  TriacDrive getDrive();
+  void setDistribution(TriacDistribution distribution);
+  TriacDistribution getDistribution();
+
  private:
-  boolean enabled;
+  volatile boolean enabled;
   int8_t triggerPin;
-  unsigned long period;  // PWM period in ms
-  unsigned long periodStartTime;  // Time when the current period started
+  double duty_cycle;
+  TriacDrive _drive;
+  volatile TriacDistribution _distribution;
+  unsigned long periodTicks;      // PWM period in ticks
+  unsigned long slotTicks;        // half cycle in ticks
+  volatile unsigned long onTicks; // on time per period in ticks
+  volatile unsigned long sdLevel; // on half cycles per TRIAC_SD_RESOLUTION
+  unsigned long sdAccumulator;
+  volatile boolean slotOn;        // sigma-delta output for the current half cycle
+  uint32_t periodStartTime;       // Time when the current period/half cycle started (polled) [us]
+  volatile unsigned long tickCount;  // ticks into the current period/half cycle (timer)
+  volatile boolean pinState;
+
+  boolean nextSlot();
+  void startTimer();
+  void stopTimer();
+  void timerTick();
+  static void timerISR();
+  static TriacOutput *_timerOutput;  // the output being driven by timer1
 };
 
 
@@ -3,25 +3,90 @@
 #include <FS.h>
 #include <ArduinoJson.h>
 #include "controller.h"
+#include "dataFrame.h"
+#include "samplePublisher.h"
+#include "roastHistory.h"
+#include "decimator.h"
+#include "paramStore.h"
+#include "params.h"
+#include "jsonWriter.h"
+#include "fanOut.h"
+#include "subscriptions.h"
+#include "loopStats.h"
+#include "logger.h"
+#include "scheduler.h"
+#include "controllerEvents.h"
+#include <lwip/tcp.h>
 
+#define HISTORY_CHUNK 32   // datapoints per backfill frame, one frame per client per loop()
+#define MAX_FRAME_SAMPLES (HISTORY_CHUNK > PUBLISH_CAPACITY ? HISTORY_CHUNK : PUBLISH_CAPACITY)
+#define STATUS_INTERVAL 250  // [ms] how often the status is checked for changes
+#define FRAME_BUFFER_SIZE 1536  // the longest outgoing message, a chunk of text datapoints
+#define DIAGNOSTICS_INTERVAL 1000  // [ms] how often the diagnostics are sent to subscribers at every update
+#define STREAM_SLICE 512  // bytes of a file sent between scheduler.yield()s
 
-typedef struct {
-  String name;
-  String dataType;
-  double doubleValue;
-  String strValue;
-  int intValue;
-} Param;
+// Every outgoing message is built here, after room for the websocket header, so the library can put the header
+// in front of it and send it without copying (headerToPayload). One message at a time.
+static uint8_t frameBuffer[WEBSOCKETS_MAX_HEADER_SIZE + FRAME_BUFFER_SIZE];
+static JsonWriter json((char *)frameBuffer + WEBSOCKETS_MAX_HEADER_SIZE, FRAME_BUFFER_SIZE);
 
-typedef struct {
-  Param data[12];
-  int numParams;
-} Status;
+// the last status sent, numbered as in the parameter table (params.cpp)
+static ParamStore status(paramDefs(), paramCount());
+static uint32_t lastStatusCheck = 0;
+
+// The websocket server, with what the fan-out needs to know about each client's TCP connection
+class SocketServer : public WebSocketsServer, public FanOutTransport {
+ public:
+  SocketServer(uint16_t port) : WebSocketsServer(port) {}
+
+  size_t writable(uint8_t num){
+    WiFiClient *tcp = _clients[num].tcp;
+    return(tcp && tcp->connected() ? tcp->availableForWrite() : 0);
+  }
+  size_t queued(uint8_t num){
+    size_t free = writable(num);
+    return(free < TCP_SND_BUF ? TCP_SND_BUF - free : 0);
+  }
+  bool send(uint8_t num, uint8_t *frame, size_t length, bool binary){
+    return(binary ? sendBIN(num, frame, length, true) : sendTXT(num, frame, length, true));
+  }
+  void disconnect(uint8_t num){
+    WebSocketsServer::disconnect(num);
+  }
+};
 
 ESP8266WebServer server = ESP8266WebServer(80);       // create a web server on port 80
-WebSocketsServer webSocket = WebSocketsServer(81);    // and listen for websocket on port 81
+static SocketServer socketServer(81);                  // and listen for websocket on port 81
+WebSocketsServer &webSocket = socketServer;
 File fsUploadFile;
 
+static FanOut fanOut(&socketServer, WEBSOCKETS_SERVER_CLIENT_MAX);
+static Subscriptions subscriptions(WEBSOCKETS_SERVER_CLIENT_MAX);
+static uint32_t lastDiagnostics = 0;
+
+// websocket clients, one bit per client number
+static uint32_t connectedClients = 0;
+static uint32_t binaryClients = 0;     // want datapoints as binary frames (see dataFrame.h)
+static uint32_t resumingClients = 0;   // being sent the history, they don't get live datapoints until they catch up
+static uint32_t resumeSeq[WEBSOCKETS_SERVER_CLIENT_MAX];  // next history sequence number to send each resuming client
+
+static void publishDatapoints(const DatapointFrame *samples, size_t count);
+static SamplePublisher publisher(publishDatapoints);
+static RoastHistory history;
+
+// the history as a series to downsample, temperature against time, indexed by sequence number
+class HistorySeries : public SampleSeries {
+ public:
+  double x(uint32_t seq) const { DatapointFrame p; history.get(seq, &p); return p.timestamp; }
+  double y(uint32_t seq) const { DatapointFrame p; history.get(seq, &p); return p.temperature; }
+};
+static HistorySeries historySeries;
+static uint32_t decimatingClients = 0; // resuming, with the history downsampled (the part before resumeSeq)
+static Lttb decimators[WEBSOCKETS_SERVER_CLIENT_MAX];
+static uint32_t statusEpoch[WEBSOCKETS_SERVER_CLIENT_MAX];  // the status epoch each client is up to date with
+static uint32_t snapshotClients = 0;   // still to be sent the whole status
+static uint32_t laggingClients = 0;    // missed some status changes, they will get them all together
+
 // Handlers
 //admin
 static void handleUpload(void);
@@ -30,24 +95,35 @@ static void handleFileUpload(void);
 static void handleFileList(void);
 static bool handleFileRead(String path);
 static void handleNotFound(void);
+static void handleMetrics(void);
 //websocket
 static void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length);
 
 
 //helpers
-static bool lookup_param_value(String param, Param *response_data);
-static bool set_param_value(String param, JsonVariant value);
-static bool run_command(String command);
-static void getStatus(Status *status);
-static void sendStatus(uint8_t num);
-static String status2JSON(Status status);
-static bool handleUpdateMessage(uint8_t *message);
+static bool set_param_value(const char *name, JsonVariant value);
+static bool run_command(uint8_t num, String command);
+static void updateStatus(void);
+static void sendStatusChanges(void);
+static bool status2JSON(uint32_t params);
+static uint32_t sendFrame(uint32_t clients, FanOutPolicy policy);
+static bool handleUpdateMessage(uint8_t num, uint8_t *message);
+static uint32_t sendDatapoints(uint32_t clients, uint8_t frameType, uint32_t seq, const DatapointFrame *samples, size_t count);
+static void sendHistory(void);
+static void sendDiagnostics(void);
+static void handleSubscriptions(uint8_t num, JsonObject &root);
+static bool loadProgram(JsonObject &program);
+static bool loadGainSchedule(JsonArray &bands);
+static void handleControllerEvents(void);
+static void stages2JSON(void);
+static void tasks2JSON(void);
 
 // Helpers
 static String getContentType(String filename);
 static String formatBytes(size_t bytes);
 static void serve_html(String path);
 static void send_404(void);
+static void streamFile(File &file, String contentType);
 
 ///////////////////////////////////
 // Setup functions
@@ -55,6 +131,7 @@ static void send_404(void);
 void webserverSetup(){
   server.on("/", HTTP_GET, [](){serve_html("/index.html");});
   server.on("/list", HTTP_GET, handleFileList);
+  server.on("/metrics", HTTP_GET, handleMetrics);
 
   //first callback is called after the request has ended with all parsed arguments
   //second callback handles file uploads at that location
@@ -66,39 +143,354 @@ void webserverSetup(){
 
   server.begin();
 
-  Serial.println("HTTP server started");
+  LOG_INFO("HTTP server started");
 
   webSocket.onEvent(webSocketEvent);
   webSocket.begin();
-  Serial.println("Websocket server started on port 81");
+  LOG_INFO("Websocket server started on port 81");
+  logSetCallback(webserverLog);
+}
+
+// [ms]
+void webserverSetPublishInterval(unsigned long interval){
+  publisher.setInterval(interval);
+}
+
+unsigned long webserverGetPublishInterval(){
+  return(publisher.getInterval());
+}
+
+void webserverSetPublishBatch(size_t batchSize){
+  publisher.setBatchSize(batchSize);
+}
+
+size_t webserverGetPublishBatch(){
+  return(publisher.getBatchSize());
+}
+
+FanOut &webserverFanOut(){
+  return(fanOut);
+}
+
+/*
+ * Run from the main loop. Takes what the controller has published, sends any datapoints which have been
+ * waiting long enough, the next chunk of history to any clients which are catching up, and any status changes.
+ */
+void webserverProcess(){
+  fanOut.process();
+  handleControllerEvents();
+  publisher.process();
+  sendHistory();
+  if((uint32_t)(millis() - lastStatusCheck) >= STATUS_INTERVAL){
+    lastStatusCheck = millis();
+    updateStatus();
+    sendStatusChanges();
+  }
+  sendDiagnostics();
+}
+
+/*
+ * Publish a batch of datapoints: number them and keep them in the history, and send them to the samples
+ * subscribers, except the clients still catching up (they will get them from the history).
+ * Subscribers at every update all get the same frame. A client too backed up to take it goes back to
+ * catching up, from these ones.
+ * Subscribers at a lower rate each get just the samples spaced out to their rate, as a decimated frame (which says
+ * where to carry on from). If one is backed up it just misses them, the next ones will do.
+ */
+void publishDatapoints(const DatapointFrame *samples, size_t count){
+  uint32_t firstSeq = history.nextSeq();
+  for(size_t i=0; i<count; i++){
+    history.add(samples[i]);
+  }
+  uint32_t live = connectedClients & ~resumingClients & subscriptions.subscribers(TOPIC_SAMPLES);
+  uint32_t everySample = live & subscriptions.unlimited(TOPIC_SAMPLES);
+  uint32_t missed = everySample & ~sendDatapoints(everySample, FRAME_DATAPOINTS, firstSeq, samples, count);
+  for(uint8_t num=0; num<WEBSOCKETS_SERVER_CLIENT_MAX; num++){
+    if(missed & (1UL << num)){
+      resumeSeq[num] = firstSeq;
+      resumingClients |= 1UL << num;
+    }
+  }
+
+  uint32_t limited = live & ~everySample;
+  for(uint8_t num=0; limited && num<WEBSOCKETS_SERVER_CLIENT_MAX; num++){
+    if(!(limited & (1UL << num))){
+      continue;
+    }
+    DatapointFrame picked[PUBLISH_CAPACITY];
+    size_t n = 0;
+    for(size_t i=0; i<count && n<PUBLISH_CAPACITY; i++){
+      // the spacing is from the last one picked (sent or not, a backed up client just misses it)
+      if(subscriptions.due(num, TOPIC_SAMPLES, samples[i].timestamp)){
+        picked[n++] = samples[i];
+        subscriptions.sent(num, TOPIC_SAMPLES, samples[i].timestamp);
+      }
+    }
+    if(n > 0){
+      sendDatapoints(1UL << num, FRAME_DECIMATED, firstSeq + count, picked, n);
+    }
+  }
+}
+
+/*
+ * Send the next HISTORY_CHUNK datapoints to each client which is catching up.
+ * If it asked for the history downsampled, that comes first, then everything since it asked.
+ * Once a client has everything in the history it goes back to getting live datapoints.
+ * Clients which are backed up are left until they can take a whole chunk.
+ */
+void sendHistory(){
+  if(!resumingClients){
+    return;
+  }
+  DatapointFrame chunk[HISTORY_CHUNK];
+  for(uint8_t num=0; num<WEBSOCKETS_SERVER_CLIENT_MAX; num++){
+    if(!(resumingClients & (1UL << num)) || !fanOut.ready(num, FRAME_BUFFER_SIZE)){
+      continue;
+    }
+    if(decimatingClients & (1UL << num)){
+      size_t count = 0;
+      uint32_t index = 0;
+      while(count < HISTORY_CHUNK && decimators[num].next(historySeries, &index)){
+        history.get(index, &chunk[count++]);
+      }
+      if(count > 0){
+        sendDatapoints(1UL << num, FRAME_DECIMATED, index + 1, chunk, count);
+      }
+      if(decimators[num].done()){
+        decimatingClients &= ~(1UL << num);
+      }
+      continue;
+    }
+    uint32_t seq = resumeSeq[num];
+    size_t count = history.read(&seq, chunk, HISTORY_CHUNK);
+    if(count > 0 && !sendDatapoints(1UL << num, FRAME_DATAPOINTS, seq, chunk, count)){
+      continue;
+    }
+    resumeSeq[num] = seq + count;
+    if(count < HISTORY_CHUNK){
+      resumingClients &= ~(1UL << num);
+    }
+  }
+}
+
+/*
+ * Send some datapoints as one frame to each of the clients (one bit per client number)
+ * frameType is FRAME_DATAPOINTS (seq is the first sample's sequence number)
+ * or FRAME_DECIMATED (seq is the one to carry on from).
+ * Clients which asked for binary datapoints get a binary frame, built on the stack.
+ * The others get {"type":"data","seq":seq,"data":"t,setpoint,output,temperature;t,..."} ("next":seq if decimated),
+ * which is only built if there are any.
+ * Returns the clients they were sent to.
+ */
+uint32_t sendDatapoints(uint32_t clients, uint8_t frameType, uint32_t seq, const DatapointFrame *samples, size_t count){
+  uint32_t sent = 0;
+  uint32_t toBinary = clients & binaryClients;
+  if(toBinary){
+    uint8_t *frame = frameBuffer + WEBSOCKETS_MAX_HEADER_SIZE;
+    size_t len;
+    if(frameType == FRAME_DECIMATED){
+      len = encodeDecimatedFrame(frame, FRAME_BUFFER_SIZE, seq, samples, count);
+    }else{
+      len = encodeDatapointsFrame(frame, FRAME_BUFFER_SIZE, seq, samples, count);
+    }
+    sent |= fanOut.send(toBinary, frameBuffer, len, true, FANOUT_COALESCE);
+  }
+
+  uint32_t toText = clients & ~binaryClients;
+  if(toText){
+    json.clear();
+    json.beginObject();
+    json.key("type"); json.value("data");
+    json.key(frameType == FRAME_DECIMATED ? "next" : "seq"); json.value((unsigned long)seq);
+    json.key("data");
+    json.beginString();
+    for(size_t i=0; i<count; i++){
+      if(i > 0){
+        json.stringPart(";");
+      }
+      json.stringPart(samples[i].timestamp/1000.0, 3); json.stringPart(",");
+      json.stringPart(samples[i].setpoint, 2); json.stringPart(",");
+      json.stringPart(samples[i].output, 2); json.stringPart(",");
+      json.stringPart(samples[i].temperature, 2);
+    }
+    json.endString();
+    json.endObject();
+    LOG_DEBUG("%s", json.c_str());
+    sent |= sendFrame(toText, FANOUT_COALESCE);
+  }
+  return(sent);
+}
+
+/*
+ * Send the text message in the frame buffer to each of the clients (one bit per client number) which can take it
+ * If it didn't fit, nobody gets it. Returns the clients it was sent to.
+ */
+uint32_t sendFrame(uint32_t clients, FanOutPolicy policy){
+  if(json.overflowed()){
+    LOG_ERROR("Message too long for the frame buffer, not sent");
+    return(0);
+  }
+  return(fanOut.send(clients, frameBuffer, json.length(), false, policy));
+}
+
+/*
+ * Send a log line to the logs subscribers. Those at a limited rate miss the lines which come too soon.
+ * This is the logger's callback (logger.h), called as the queued lines are drained at the end of loop().
+ */
+void webserverLog(uint8_t level, const char *log){
+  uint32_t clients = 0;
+  for(uint8_t num=0; num<WEBSOCKETS_SERVER_CLIENT_MAX; num++){
+    if((connectedClients & (1UL << num)) && subscriptions.due(num, TOPIC_LOGS, millis())){
+      clients |= 1UL << num;
+    }
+  }
+  if(!clients){
+    return;
+  }
+  json.clear();
+  json.beginObject();
+  json.key("type"); json.value("log");
+  json.key("level"); json.value(logLevelName(level));
+  json.key("data"); json.value(log);
+  json.endObject();
+  uint32_t sent = sendFrame(clients, FANOUT_DROP);
+  for(uint8_t num=0; num<WEBSOCKETS_SERVER_CLIENT_MAX; num++){
+    if(sent & (1UL << num)){
+      subscriptions.sent(num, TOPIC_LOGS, millis());
+    }
+  }
+}
+
+/*
+ * Send the diagnostics (the parameters flagged PARAM_DIAGNOSTIC) to the subscribers which are due them
+ * {"type":"diagnostics","data":{"param":value,...}}
+ */
+void sendDiagnostics(){
+  uint32_t subscribers = connectedClients & subscriptions.subscribers(TOPIC_DIAGNOSTICS);
+  if(!subscribers){
+    return;
+  }
+  // at every update is every DIAGNOSTICS_INTERVAL
+  bool tick = (uint32_t)(millis() - lastDiagnostics) >= DIAGNOSTICS_INTERVAL;
+  if(tick){
+    lastDiagnostics = millis();
+  }
+  uint32_t clients = 0;
+  for(uint8_t num=0; num<WEBSOCKETS_SERVER_CLIENT_MAX; num++){
+    if(!(subscribers & (1UL << num))){
+      continue;
+    }
+    if(subscriptions.getInterval(num, TOPIC_DIAGNOSTICS) == 0 ? tick : subscriptions.due(num, TOPIC_DIAGNOSTICS, millis())){
+      clients |= 1UL << num;
+    }
+  }
+  if(!clients){
+    return;
+  }
+  const ParamDef *defs = paramDefs();
+  json.clear();
+  json.beginObject();
+  json.key("type"); json.value("diagnostics");
+  json.key("data");
+  json.beginObject();
+  for(uint8_t i=0; i<paramCount(); i++){
+    if(defs[i].flags & PARAM_DIAGNOSTIC){
+      json.key(defs[i].name);
+      json.value(defs[i].get());
+    }
+  }
+  json.endObject();
+  stages2JSON();
+  tasks2JSON();
+  json.endObject();
+  uint32_t sent = sendFrame(clients, FANOUT_DROP);
+  for(uint8_t num=0; num<WEBSOCKETS_SERVER_CLIENT_MAX; num++){
+    if(sent & (1UL << num)){
+      subscriptions.sent(num, TOPIC_DIAGNOSTICS, millis());
+    }
+  }
 }
 
 /*
- * push a datapoint to any connected websocket clients
+ * The loop stage timings, "stages":{"controller":{"count":..,"p50":..,"p99":..,"max":..,"overruns":..},..} [us]
  */
-void webserverPushDatapoint(uint32_t timestamp, double setpoint, double output, double temperature){
-  StaticJsonBuffer<500> jsonBuffer;
-  JsonObject& root = jsonBuffer.createObject();
-  root["type"] = "data";
-  root["data"] = String(timestamp) + String(",") + String(setpoint) + String(",") + String(output) + String(",") + String(temperature);
-  root.printTo(Serial);Serial.println("");
-  String dataString;
-  root.printTo(dataString);
-  webSocket.broadcastTXT(dataString);
+void stages2JSON(){
+  json.key("stages");
+  json.beginObject();
+  for(uint8_t s=0; s<NUM_STAGES; s++){
+    LatencyHistogram &h = loopStats.stage[s];
+    json.key(LoopStats::name((LoopStage)s));
+    json.beginObject();
+    json.key("count"); json.value(h.getCount());
+    json.key("p50"); json.value(LoopStats::toMicros(h.percentile(0.5)));
+    json.key("p99"); json.value(LoopStats::toMicros(h.percentile(0.99)));
+    json.key("max"); json.value(LoopStats::toMicros(h.getMax()));
+    json.key("overruns"); json.value(h.getOverruns());
+    json.endObject();
+  }
+  json.endObject();
 }
 
-void webserverLog(String log){
-  webSocket.broadcastTXT(String("{\"type\":\"log\",\"data\":\"") + log + String("\"}"));
+/*
+ * The scheduler's tasks, "tasks":{"control":{"runs":..,"late_p99":..,"late_max":..,"misses":..},..} [us]
+ */
+void tasks2JSON(){
+  json.key("tasks");
+  json.beginObject();
+  for(uint8_t t=0; t<scheduler.count(); t++){
+    Task &task = scheduler.task(t);
+    json.key(task.name);
+    json.beginObject();
+    json.key("runs"); json.value(task.runs);
+    json.key("late_p99"); json.value(task.lateness.percentile(0.99));
+    json.key("late_max"); json.value(task.lateness.getMax());
+    json.key("misses"); json.value(scheduler.getMisses(t));
+    json.endObject();
+  }
+  json.endObject();
 }
 
-void webserverPushData(String name, double data){
-  Status status;
-  status.numParams = 1;
-  status.data[0].name = name;
-  status.data[0].doubleValue = data;
-  status.data[0].dataType = "double";
-  String statusString = status2JSON(status);
-  webSocket.broadcastTXT(statusString);
+/*
+ * Deal with everything the controller has published (controllerEvents.h)
+ * Datapoints are batched up by the publisher, and sent from publishDatapoints() a few at a time. Temperatures
+ * go in the status, with the next status changes. A state change or fault goes out to everyone now.
+ */
+void handleControllerEvents(){
+  static const char *stateNames[] = {"off", "preheating", "preheat", "ramping", "hold", "cooling"};
+  bool statusNow = false;
+  ControllerEventQueue &events = controllerEvents();
+  ControllerEvent *event;
+  while((event = events.front()) != NULL){
+    switch(event->type){
+      case EVENT_SAMPLE:
+        publisher.add(event->sample);
+        break;
+      case EVENT_TEMPERATURE:
+        status.set(paramFind("temperature"), event->temperature.measured);
+        if(!isnan(event->temperature.estimated)){
+          status.set(paramFind("estimated_temperature"), event->temperature.estimated);
+        }
+        break;
+      case EVENT_STATE:
+        LOG_INFO("Controller %s, %s mode", event->state.state <= COOLING ? stateNames[event->state.state] : "?",
+                 event->state.programMode == PROGRAM ? "program" : "simple");
+        statusNow = true;
+        break;
+      case EVENT_FAULT:
+        if(event->fault.fault){
+          LOG_WARN("Thermocouple fault: %u (%lu so far)", event->fault.fault, (unsigned long)event->fault.count);
+        }else{
+          LOG_INFO("Thermocouple fault cleared");
+        }
+        statusNow = true;
+        break;
+    }
+    events.pop();
+  }
+  if(statusNow){
+    updateStatus();
+    sendStatusChanges();
+  }
 }
 
 
@@ -106,57 +498,108 @@ void webserverPushData(String name, double data){
  * Callback whenever a websocket message is received
  */
 void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
-  Serial.printf("Websocket Event started\n");
   switch(type) {
     case WStype_DISCONNECTED:
-      Serial.printf("[%u] Disconnected!\n", num);
+      LOG_INFO("[%u] Disconnected", num);
+      connectedClients &= ~(1UL << num);
+      binaryClients &= ~(1UL << num);
+      resumingClients &= ~(1UL << num);
+      decimatingClients &= ~(1UL << num);
+      snapshotClients &= ~(1UL << num);
+      laggingClients &= ~(1UL << num);
+      fanOut.reset(num);
+      subscriptions.reset(num);
       break;
     case WStype_CONNECTED:
       // Send the status immediately on connection
       {
         IPAddress ip = webSocket.remoteIP(num);
-        Serial.printf("[%u] Connected from %d.%d.%d.%d url: %s\n", num, ip[0], ip[1], ip[2], ip[3], payload);
+        LOG_INFO("[%u] Connected from %d.%d.%d.%d url: %s", num, ip[0], ip[1], ip[2], ip[3], payload);
       }
-      sendStatus(num);
+      connectedClients |= 1UL << num;
+      binaryClients &= ~(1UL << num);
+      resumingClients &= ~(1UL << num);
+      decimatingClients &= ~(1UL << num);
+      snapshotClients |= 1UL << num;
+      laggingClients &= ~(1UL << num);
+      fanOut.reset(num);
+      subscriptions.reset(num);
+      updateStatus();
+      sendStatusChanges();
       break;
     case WStype_TEXT:
-      Serial.printf("[%u] get Text: %s\n", num, payload);
-      handleUpdateMessage(payload);
-      sendStatus(num);
+      // whatever it changed goes out to everyone now, rather than at the next status check
+      LOG_DEBUG("[%u] get Text: %s", num, payload);
+      handleUpdateMessage(num, payload);
+      updateStatus();
+      sendStatusChanges();
       break;
     case WStype_BIN:
-      Serial.printf("[%u] get binary length: %u\n", num, length);
+      LOG_WARN("[%u] get binary length: %u", num, (unsigned)length);
       webSocket.sendTXT(num, "Binary data not supported");
       break;
     case WStype_ERROR:
-      Serial.printf("[%u] error\n", num);
+      LOG_WARN("[%u] error", num);
       break;
     default:
-      Serial.printf("Unhandled websocket type: <%d>\n", type);
+      LOG_WARN("Unhandled websocket type: <%d>", type);
       break;
   }
 }
 
 
 /*
- * Send the status to client number "num"
+ * Send each client the status parameters which have changed since it was last sent them,
+ * or the whole status if it has just connected.
+ * Usually they are all up to date with the same epoch, so the message is only built once.
+ * A client which is backed up, or subscribed at a lower rate and not due, stays at the epoch it had,
+ * and gets everything it missed in one go later on.
  */
-void sendStatus(uint8_t num){
-  Status status;
-  getStatus(&status);
-  String statusString = status2JSON(status);
-  webSocket.sendTXT(num, statusString);
+void sendStatusChanges(){
+  if(!status.dirty() && !(snapshotClients | laggingClients)){
+    return;
+  }
+  uint32_t builtFor = 0;
+  for(uint8_t num=0; num<WEBSOCKETS_SERVER_CLIENT_MAX; num++){
+    uint32_t bit = 1UL << num;
+    if(!(connectedClients & bit) || !subscriptions.subscribed(num, TOPIC_STATUS)){
+      continue;
+    }
+    uint32_t changed = (snapshotClients & bit) ? status.all() : status.changedSince(statusEpoch[num]);
+    if(changed){
+      if(!(snapshotClients & bit) && !subscriptions.due(num, TOPIC_STATUS, millis())){
+        // too soon for its rate, it gets everything since its epoch when it is due
+        laggingClients |= bit;
+        continue;
+      }
+      if(changed != builtFor){
+        status2JSON(changed);
+        builtFor = changed;
+      }
+      if(!sendFrame(bit, FANOUT_COALESCE)){
+        laggingClients |= bit;
+        continue;
+      }
+      subscriptions.sent(num, TOPIC_STATUS, millis());
+    }
+    statusEpoch[num] = status.epoch();
+    snapshotClients &= ~bit;
+    laggingClients &= ~bit;
+  }
+  status.clearDirty();
 }
 
 /*
  * Called whenever we receive a message from the client.
- * It should handle updating parameters and running commands.
+ * It should handle updating parameters, running commands, subscriptions, and resuming the datapoint stream.
  */
-bool handleUpdateMessage(uint8_t *message){
+bool handleUpdateMessage(uint8_t num, uint8_t *message){
   bool error = false;
   
   //parse the JSON input
-  StaticJsonBuffer<500> jsonBuffer;
+  // room for a whole program and gain schedule as well as the usual parameters and commands
+  StaticJsonBuffer<500 + JSON_OBJECT_SIZE(3) + JSON_ARRAY_SIZE(PROFILE_MAX_STEPS) + PROFILE_MAX_STEPS*JSON_OBJECT_SIZE(4) +
+                   JSON_ARRAY_SIZE(PID_MAX_BANDS) + PID_MAX_BANDS*JSON_ARRAY_SIZE(GAIN_BAND_FIELDS)> jsonBuffer;
   JsonObject& root = jsonBuffer.parseObject(message);
   if(root.success()){  
     //Check if we need to set any parameters
@@ -170,7 +613,31 @@ bool handleUpdateMessage(uint8_t *message){
     if(root.containsKey("commands")){
       JsonArray& commands = root["commands"];
       for (const auto& element: commands){
-        run_command(element.as<char*>());
+        run_command(num, element.as<char*>());
+      }
+    }
+    handleSubscriptions(num, root);
+    if(root.containsKey("program")){
+      loadProgram(root["program"]);
+    }
+    if(root.containsKey("gain_schedule")){
+      loadGainSchedule(root["gain_schedule"]);
+    }
+    //Send the client the datapoints it missed, from sequence number "resume" on (0 for the whole roast)
+    //they are sent a chunk at a time from webserverProcess()
+    //With "points", what is in the history now is downsampled to that many points
+    if(root.containsKey("resume")){
+      resumeSeq[num] = root["resume"].as<unsigned long>();
+      resumingClients |= 1UL << num;
+      decimatingClients &= ~(1UL << num);
+      if(root.containsKey("points") && root["points"].as<long>() > 0 && history.size() > 0){
+        uint32_t start = resumeSeq[num];
+        if(start - history.firstSeq() > history.size()){
+          start = history.firstSeq();
+        }
+        decimators[num].begin(start, history.nextSeq(), root["points"].as<long>());
+        decimatingClients |= 1UL << num;
+        resumeSeq[num] = history.nextSeq();
       }
     }
   }else{
@@ -182,138 +649,206 @@ bool handleUpdateMessage(uint8_t *message){
 
 
 /*
- * populate a status cluster with data
+ * {"subscribe":{"topic":rate,...}} subscribes to each topic at no more than rate [Hz], 0 for every update
+ * {"unsubscribe":["topic",...]}
+ * Topics are samples, status, logs and diagnostics.
  */
-void getStatus(Status *status){
-  Serial.printf("Getting status\n");
-  status->numParams = 0;
-  
-  int num_params = 8;
-  String params[] = {"p", "i", "d", "setpoint", "temperature", "programMode", "state", "duty_cycle"};
-  for(int i=0; i<num_params; i++){
-    lookup_param_value(params[i], &status->data[i]);
-    status->numParams++;
+void handleSubscriptions(uint8_t num, JsonObject &root){
+  if(root.containsKey("subscribe")){
+    JsonObject& topics = root["subscribe"];
+    for(const auto& element: topics){
+      int8_t topic = Subscriptions::find(element.key);
+      if(topic < 0){
+        LOG_WARN("Unknown topic: %s", element.key);
+        continue;
+      }
+      if(topic == TOPIC_STATUS && !subscriptions.subscribed(num, TOPIC_STATUS)){
+        // it doesn't have the status, so it needs all of it
+        snapshotClients |= 1UL << num;
+      }
+      subscriptions.subscribe(num, (Topic)topic, element.value.as<double>());
+    }
+  }
+  if(root.containsKey("unsubscribe")){
+    JsonArray& topics = root["unsubscribe"];
+    for(const auto& element: topics){
+      int8_t topic = Subscriptions::find(element.as<const char*>());
+      if(topic >= 0){
+        subscriptions.unsubscribe(num, (Topic)topic);
+      }
+      if(topic == TOPIC_SAMPLES){
+        resumingClients &= ~(1UL << num);
+        decimatingClients &= ~(1UL << num);
+      }
+    }
+  }
+}
+
+
+/*
+ * {"program":{"program_name":name, "preheat_temp":oC,
+ *             "program_steps":[{"step_name":name, "target_temp":oC, "ramp_rate":oC/min, "hold_time":s}, ...]}}
+ * replaces the program mode profile (see roastProfile.h). Not while a program is running.
+ */
+bool loadProgram(JsonObject &program){
+  if(controller.programMode == PROGRAM && controller.state != OFF){
+    LOG_WARN("Can't load a program while one is running");
+    return(false);
+  }
+  RoastProfile &profile = controller.profile;
+  profile.clear();
+  profile.setName(program["program_name"].as<const char*>());
+  // a missing or null temperature reads as 0, which is a valid one, so they have to be numbers
+  // (a blank row in the page's table is sent as null). A missing ramp rate or hold time is 0, which is what it means.
+  bool ok = (program["preheat_temp"].is<float>() || program["preheat_temp"].is<long>()) &&
+            profile.setPreheat(program["preheat_temp"].as<float>());
+  JsonArray& steps = program["program_steps"];
+  for(const auto& element: steps){
+    JsonObject& step = element.as<JsonObject&>();
+    ok = ok && (step["target_temp"].is<float>() || step["target_temp"].is<long>()) &&
+         profile.addStep(step["target_temp"].as<float>(), step["ramp_rate"].as<float>(), step["hold_time"].as<float>());
+  }
+  if(!ok || !profile.compile()){
+    LOG_WARN("Bad program, at most %d steps of temperatures up to %d oC", PROFILE_MAX_STEPS, PROFILE_MAX_TEMPERATURE);
+    profile.clear();
+    return(false);
   }
+  LOG_INFO("Loaded program %s: %d steps, %.0f s", profile.getName(), profile.stepCount(), profile.duration());
+  return(true);
 }
 
 
-bool run_command(String command){
+/*
+ * {"gain_schedule":[[temperature, p, i, d], ...]} schedules the PID gains on the setpoint, temperatures going up
+ * (see mypid.h). One band is fixed gains. Setting p, i or d afterwards sets it in every band.
+ */
+bool loadGainSchedule(JsonArray &bands){
+  double schedule[PID_MAX_BANDS][GAIN_BAND_FIELDS];
+  uint8_t count = 0;
+  for(const auto& band: bands){
+    if(count >= PID_MAX_BANDS){
+      count = 0;
+      break;
+    }
+    for(uint8_t f=0; f<GAIN_BAND_FIELDS; f++){
+      schedule[count][f] = band[f].as<double>();
+    }
+    count++;
+  }
+  if(!controller.setGainSchedule(count, schedule)){
+    LOG_WARN("Bad gain schedule, 1 to %d bands of [temperature, p, i, d], temperatures going up, gains up to %d", PID_MAX_BANDS, PID_MAX_GAIN);
+    return(false);
+  }
+  LOG_INFO("Gain schedule of %d bands", count);
+  return(true);
+}
+
+
+/*
+ * Read the current values into the status store, marking any which have changed
+ * Only cheap getters, the temperature is the thermocouple's last reading.
+ */
+void updateStatus(){
+  // while the PID is running the live ones go out in the datapoints instead
+  bool running = controller.isHeating() && controller.thermocouple.isValid();
+  const ParamDef *defs = paramDefs();
+  for(uint8_t i=0; i<paramCount(); i++){
+    if((defs[i].flags & PARAM_STATUS) && !(running && (defs[i].flags & PARAM_LIVE))){
+      status.set(i, defs[i].get());
+    }
+  }
+}
+
+
+bool run_command(uint8_t num, String command){
   bool success = false;
-  if(command == "start"){
-    Serial.println("  Starting controller");
+  if(command == "binary_data"){
+    LOG_INFO("Sending binary datapoints");
+    binaryClients |= 1UL << num;
+    success = true;
+  }else if(command == "text_data"){
+    LOG_INFO("Sending JSON datapoints");
+    binaryClients &= ~(1UL << num);
+    success = true;
+  }else if(command == "preheat"){
+    LOG_INFO("Preheating");
+    success = controller.preheat();
+  }else if(command == "start"){
+    LOG_INFO("Starting controller");
     controller.start();
     success = true;
   }else if(command == "stop"){
-    Serial.println("  Stopping controller");
+    LOG_INFO("Stopping controller");
     controller.stop();
     success = true;
   }else if(command == "restart"){
-    Serial.println("  Restarting controller");
+    LOG_INFO("Restarting controller");
     controller.restart();
     success = true;
+  }else if(command == "reset_metrics"){
+    LOG_INFO("Clearing loop timings");
+    loopStats.clear();
+    scheduler.clear();
+    success = true;
   }else if(command == "saveConfig"){
-    Serial.println("  Saving controller config");
+    LOG_INFO("Saving controller config");
     controller.saveConfig();
     success = true;
   }else if(command == "simple_mode"){
-    Serial.println("  Switch to simple mode - Not implemented yet");
-    success = true;
+    LOG_INFO("Switching to simple mode");
+    success = controller.setProgramMode(SIMPLE);
   }else if(command == "program_mode"){
-    Serial.println("  Switch to program mode - Not implemented yet");
-    success = true;
+    LOG_INFO("Switching to program mode");
+    success = controller.setProgramMode(PROGRAM);
   }else{
-    Serial.print("  Unknown command: "); Serial.println(command);
+    LOG_WARN("Unknown command: %s", command.c_str());
     success = false;
   }
   return(success);
 }
 
 /*
- * Look up the value of parameter "param"
- * Populate the response_data struct
- * return true/false for found/not found
+ * Set a parameter from the websocket. It has to be writable, and a number of the right type.
  */
-bool lookup_param_value(String param, Param *response_data){
-  response_data->name = param;
-  if(param == "p"){
-    response_data->doubleValue = controller.getP();
-    response_data->dataType = "double";
-  }else if(param == "i"){
-    response_data->doubleValue = controller.getI();
-    response_data->dataType = "double";
-  }else if(param == "d"){
-    response_data->doubleValue = controller.getD();
-    response_data->dataType = "double";
-  }else if(param == "setpoint"){
-    response_data->doubleValue = controller.getSetpoint();
-    response_data->dataType = "double";
-  }else if(param == "ramp_rate"){
-    response_data->doubleValue = controller.ramp_rate;
-    response_data->dataType = "double";
-  }else if(param == "temperature"){
-    response_data->doubleValue = controller.getTemperature();
-    response_data->dataType = "double";
-  }else if(param == "programMode"){
-    response_data->doubleValue = controller.programMode;
-    response_data->dataType = "double";
-  }else if(param == "state"){
-    response_data->doubleValue = controller.state;
-    response_data->dataType = "double";
-  }else if(param == "duty_cycle"){
-    response_data->doubleValue = controller.triac.duty_cycle;
-    response_data->dataType = "double";           
-  }else{
-    return false;
+bool set_param_value(const char *name, JsonVariant value){
+  int8_t param = paramFind(name);
+  if(param < 0){
+    LOG_WARN("Unknown parameter: %s", name);
+    return(false);
   }
-  return true;
-}
-
-
-bool set_param_value(String param, JsonVariant value){
-  bool status = false;
-  if(param == "p" && value.is<float>()){
-    controller.setP(value.as<float>());
-    status = true;
-  }else if(param == "i" && value.is<float>()){
-    controller.setI(value.as<float>());
-    status = true;
-  }else if(param == "d" && value.is<float>()){
-    controller.setD(value.as<float>());
-    status = true;
-  }else if(param == "setpoint" && value.is<float>()){
-    controller.setSetpoint(value.as<float>());
-    status = true;
-  }else if(param == "ramp_rate" && value.is<float>()){
-    controller.ramp_rate = value.as<float>();
-    status = true;
+  const ParamDef &def = paramDefs()[param];
+  if(!(def.flags & PARAM_WRITABLE)){
+    return(false);
+  }
+  if(def.type == PARAM_INT ? !value.is<int>() : !value.is<float>()){
+    return(false);
   }
-  return(status);
+  return(paramSet(param, value.as<double>()));
 }
 
 
 /*
- * Convert a status struct into a json status string
+ * Build a json status message with the parameters in the bitmask, in the frame buffer
+ * {"type":"status","data":{"param":value,...}}
+ * Returns false if it didn't fit.
  */
-String status2JSON(Status status){
-  StaticJsonBuffer<500> jsonBuffer;
-  JsonObject& root = jsonBuffer.createObject();
-  root["type"] = "status";
-  JsonObject& data = root.createNestedObject("data");
-  for(int i=0; i<status.numParams; i++){
-    if(status.data[i].dataType == "double"){
-      data[status.data[i].name] = status.data[i].doubleValue;
-    }else if(status.data[i].dataType == "int"){
-      data[status.data[i].name] = status.data[i].intValue;
-    }else if(status.data[i].dataType == "string"){
-      data[status.data[i].name] = status.data[i].strValue;
-    }else{
-      Serial.print("Unknown data type: ");Serial.println(status.data[i].dataType);
+bool status2JSON(uint32_t params){
+  const ParamDef *defs = paramDefs();
+  json.clear();
+  json.beginObject();
+  json.key("type"); json.value("status");
+  json.key("data");
+  json.beginObject();
+  for(uint8_t i=0; i<paramCount(); i++){
+    if(params & (1UL << i)){
+      json.key(defs[i].name);
+      json.value(status.get(i));
     }
   }
-  root.printTo(Serial);Serial.println("");
-  String statusString;
-  root.printTo(statusString);
-  return(statusString);
+  json.endObject();
+  json.endObject();
+  LOG_DEBUG("%s", json.c_str());
+  return(!json.overflowed());
 }
 
 
@@ -326,23 +861,19 @@ void handleUpload(){
 // Upload a new file to the SPIFFS
 void handleFileUpload(){
   HTTPUpload& upload = server.upload();
-  Serial.print("Uploading file: "); Serial.println(upload.filename);
   if(upload.status == UPLOAD_FILE_START){
-    Serial.println("Starting file upload...");
     String filename = upload.filename;
     if(!filename.startsWith("/")) filename = "/"+filename;
-    Serial.print("handleFileUpload Name: "); Serial.println(filename);
+    LOG_INFO("Uploading file: %s", filename.c_str());
     fsUploadFile = SPIFFS.open(filename, "w");            // Open the file for writing in SPIFFS (create if it doesn't exist)
     filename = String();
   } else if(upload.status == UPLOAD_FILE_WRITE){
-    Serial.println("Performing file upload...");
     if(fsUploadFile)
       fsUploadFile.write(upload.buf, upload.currentSize); // Write the received bytes to the file
   } else if(upload.status == UPLOAD_FILE_END){
-    Serial.println("Finished file upload");
     if(fsUploadFile) {                                    // If the file was successfully created
       fsUploadFile.close();                               // Close the file again
-      Serial.print("handleFileUpload Size: "); Serial.println(upload.totalSize);
+      LOG_INFO("Uploaded %u bytes", (unsigned)upload.totalSize);
       server.sendHeader("Location","/upload");      // Redirect the client to the success page
       server.send(303);
     } else {
@@ -376,7 +907,7 @@ void handleFileList() {
     path = "/";
   }
   
-  Serial.println("handleFileList: " + path);
+  LOG_INFO("handleFileList: %s", path.c_str());
   Dir dir = SPIFFS.openDir(path);
 
   String output = "[";
@@ -404,7 +935,7 @@ void handleFileList() {
 
 // send the right file to the client (if it exists)
 bool handleFileRead(String path) {
-  Serial.println("handleFileRead: " + path);
+  LOG_DEBUG("handleFileRead: %s", path.c_str());
   if (path.endsWith("/")) path += "index.html";         // If a folder is requested, send the index file
   String contentType = getContentType(path);            // Get the MIME type
   String pathWithGz = path + ".gz";
@@ -412,15 +943,88 @@ bool handleFileRead(String path) {
     if(SPIFFS.exists(pathWithGz))
       path += ".gz";
     File file = SPIFFS.open(path, "r");
-    server.streamFile(file, contentType);
+    streamFile(file, contentType);
     file.close();
     return true;
   }
-  Serial.println("handleFileRead: " + path);
-  Serial.println("\tFile Not Found");
+  LOG_DEBUG("handleFileRead: %s not found", path.c_str());
   return false;                                         // If the file doesn't exist, return false
 }
 
+/*
+ * The loop stage and task timings and the diagnostics in the Prometheus text format, a line at a time
+ */
+void handleMetrics(){
+  char line[112];
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/plain; version=0.0.4", "");
+
+  server.sendContent("# TYPE roaster_stage_us summary\n");
+  for(uint8_t s=0; s<NUM_STAGES; s++){
+    LatencyHistogram &h = loopStats.stage[s];
+    const char *name = LoopStats::name((LoopStage)s);
+    snprintf(line, sizeof(line), "roaster_stage_us{stage=\"%s\",quantile=\"0.5\"} %lu\n", name, (unsigned long)LoopStats::toMicros(h.percentile(0.5)));
+    server.sendContent(line);
+    snprintf(line, sizeof(line), "roaster_stage_us{stage=\"%s\",quantile=\"0.99\"} %lu\n", name, (unsigned long)LoopStats::toMicros(h.percentile(0.99)));
+    server.sendContent(line);
+    snprintf(line, sizeof(line), "roaster_stage_us{stage=\"%s\",quantile=\"1\"} %lu\n", name, (unsigned long)LoopStats::toMicros(h.getMax()));
+    server.sendContent(line);
+    snprintf(line, sizeof(line), "roaster_stage_us_count{stage=\"%s\"} %lu\n", name, (unsigned long)h.getCount());
+    server.sendContent(line);
+    scheduler.yield();
+  }
+  server.sendContent("# TYPE roaster_stage_overruns_total counter\n");
+  for(uint8_t s=0; s<NUM_STAGES; s++){
+    snprintf(line, sizeof(line), "roaster_stage_overruns_total{stage=\"%s\"} %lu\n", LoopStats::name((LoopStage)s), (unsigned long)loopStats.stage[s].getOverruns());
+    server.sendContent(line);
+  }
+  scheduler.yield();
+
+  server.sendContent("# TYPE roaster_task_late_us summary\n");
+  for(uint8_t t=0; t<scheduler.count(); t++){
+    Task &task = scheduler.task(t);
+    snprintf(line, sizeof(line), "roaster_task_late_us{task=\"%s\",quantile=\"0.99\"} %lu\n", task.name, (unsigned long)task.lateness.percentile(0.99));
+    server.sendContent(line);
+    snprintf(line, sizeof(line), "roaster_task_late_us{task=\"%s\",quantile=\"1\"} %lu\n", task.name, (unsigned long)task.lateness.getMax());
+    server.sendContent(line);
+    snprintf(line, sizeof(line), "roaster_task_runs_total{task=\"%s\"} %lu\n", task.name, (unsigned long)task.runs);
+    server.sendContent(line);
+    snprintf(line, sizeof(line), "roaster_task_misses_total{task=\"%s\"} %lu\n", task.name, (unsigned long)scheduler.getMisses(t));
+    server.sendContent(line);
+    scheduler.yield();
+  }
+
+  const ParamDef *defs = paramDefs();
+  for(uint8_t i=0; i<paramCount(); i++){
+    if(defs[i].flags & PARAM_DIAGNOSTIC){
+      snprintf(line, sizeof(line), "roaster_%s %.3f\n", defs[i].name, defs[i].get());
+      server.sendContent(line);
+    }
+  }
+  server.sendContent("");
+}
+
+/*
+ * Send a file a slice at a time, letting the control and websocket tasks run in between
+ * (server.streamFile() would send it all in one go)
+ */
+void streamFile(File &file, String contentType){
+  server.setContentLength(file.size());
+  if(String(file.name()).endsWith(".gz") && contentType != "application/x-gzip" && contentType != "application/octet-stream"){
+    server.sendHeader("Content-Encoding", "gzip");
+  }
+  server.send(200, contentType, "");
+  WiFiClient client = server.client();
+  uint8_t slice[STREAM_SLICE];
+  while(file.available() && client.connected()){
+    size_t length = file.read(slice, sizeof(slice));
+    if(length == 0 || client.write(slice, length) != length){
+      break;
+    }
+    scheduler.yield();
+  }
+}
+
 void handleNotFound(){
   if (!handleFileRead(server.uri())){
     send_404();
@@ -463,7 +1067,7 @@ String formatBytes(size_t bytes){
 
 
 void serve_html(String path){
-  Serial.print("Attempting to serve html file: "); Serial.println(path);
+  LOG_DEBUG("Attempting to serve html file: %s", path.c_str());
   if (!handleFileRead(path)){
     server.send(404, "text/plain", String("404: Not Found: ") + path); // otherwise, respond with a 404 (Not Found) error
   }
@@ -482,6 +1086,6 @@ void send_404(){
       message += " " + server.argName(i) + ": " + server.arg(i) + "\n";
     }
     server.send(404, "text/plain", message);
-    Serial.println(message);
+    LOG_WARN("File Not Found: %s", server.uri().c_str());
 }
 
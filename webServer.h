@@ -13,14 +13,20 @@
 #include <WiFiClient.h>
 #include <ESP8266WebServer.h>
 #include <WebSocketsServer.h>
+#include "fanOut.h"
 
 
 extern ESP8266WebServer server;
-extern WebSocketsServer webSocket;
+extern WebSocketsServer &webSocket;
 
 void webserverSetup(void);
-void webserverPushDatapoint(uint32_t timestamp, double setpoint, double output, double temperature);
-void webserverLog(String log);
-void webserverPushData(String name, double data);
+void webserverProcess(void);
+void webserverLog(uint8_t level, const char *log);
+
+void webserverSetPublishInterval(unsigned long interval);
+unsigned long webserverGetPublishInterval(void);
+void webserverSetPublishBatch(size_t batchSize);
+size_t webserverGetPublishBatch(void);
+FanOut &webserverFanOut(void);
 
 #endif  //WEBSERVER_H